@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <utility>
+
+/* Minimal benchmark registry. Every benchmark prints its results as JSON lines:
+   {"bench":"<name>","variant":"<variant>","<metric>":<value>,...} */
+namespace Bench
+{
+    using TBenchFunc = std::function<void()>;
+    using TMetrics = std::initializer_list<std::pair<const char*, double>>;
+
+    bool Register(const std::string& name, const TBenchFunc& func);
+    void Report(const std::string& name, const std::string& variant, TMetrics metrics);
+
+    /* Monotonic nanoseconds for interval measurements */
+    uint64_t NowNs();
+
+    /* Keeps measured result from being optimized out */
+    template<typename T> inline void DoNotOptimize(const T& value)
+    {
+        asm volatile("" : : "m"(value) : "memory");
+    }
+
+    /* Runs func(i) for i in [0, iterations), returns average nanoseconds per call */
+    template<typename TFunc> double MeasureNsPerCall(size_t iterations, TFunc&& func)
+    {
+        auto start = NowNs();
+        for (size_t i = 0; i < iterations; ++i) {
+            func(i);
+        }
+        return static_cast<double>(NowNs() - start) / iterations;
+    }
+}
+
+#define BENCH(name)                                                                                                    \
+    static void name##_bench();                                                                                        \
+    static const bool name##_registered = Bench::Register(#name, name##_bench);                                        \
+    static void name##_bench()
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "config.h"
+#include "gpio_chip_driver.h"
+#include "gpio_line.h"
+
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+/* Hardware-free stand-ins for benchmarks: a pipe plays the role of uAPI v1 line event fd */
+namespace Bench
+{
+    class TGpioLine: public ::TGpioLine
+    {
+    public:
+        TGpioLine(const TGpioLineConfig& config): ::TGpioLine(config)
+        {}
+        bool IsOutput() const
+        {
+            return false;
+        }
+        std::string DescribeShort() const
+        {
+            return "bench line " + GetConfig()->Name;
+        }
+    };
+
+    class TGpioChipDriver: public ::TGpioChipDriver
+    {
+    public:
+        /* Adds interrupt-driven input line, listened by fd. Driver closes fd on destruction */
+        PGpioLine AddInputLine(const std::string& name, int fd)
+        {
+            TGpioLineConfig config;
+            config.Name = name;
+            config.Direction = EGpioDirection::Input;
+            config.DebounceTimeout = std::chrono::hours(1); // keep debounce timers out of measurements
+
+            auto line = std::make_shared<Bench::TGpioLine>(config);
+            line->SetInterruptSupport(EInterruptSupport::YES);
+            Lines[fd].push_back(line);
+            return line;
+        }
+    };
+
+    struct TEventPipe
+    {
+        int ReadFd;
+        int WriteFd;
+
+        TEventPipe()
+        {
+            int fds[2];
+            if (pipe2(fds, O_NONBLOCK) < 0) {
+                throw std::runtime_error("pipe2 failed");
+            }
+            ReadFd = fds[0];
+            WriteFd = fds[1];
+        }
+
+        /* Writes alternating rising/falling edges 1us apart */
+        void WriteBurst(size_t edges)
+        {
+            // uAPI v1 timestamps are taken by CLOCK_REALTIME unless the kernel is told otherwise
+            auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                           .count();
+            std::vector<gpioevent_data> events(edges);
+            for (size_t i = 0; i < edges; ++i) {
+                events[i].timestamp = now + i * 1000;
+                events[i].id = (i % 2) ? GPIOEVENT_EVENT_FALLING_EDGE : GPIOEVENT_EVENT_RISING_EDGE;
+            }
+            if (write(WriteFd, events.data(), sizeof(gpioevent_data) * edges) < 0) {
+                throw std::runtime_error("write to event pipe failed");
+            }
+        }
+    };
+}
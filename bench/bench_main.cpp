@@ -0,0 +1,63 @@
+#include "bench.h"
+#include "log.h"
+
+#include <chrono>
+#include <iostream>
+#include <map>
+
+namespace
+{
+    std::map<std::string, Bench::TBenchFunc>& GetBenches()
+    {
+        static std::map<std::string, Bench::TBenchFunc> benches;
+        return benches;
+    }
+}
+
+bool Bench::Register(const std::string& name, const TBenchFunc& func)
+{
+    GetBenches()[name] = func;
+    return true;
+}
+
+void Bench::Report(const std::string& name, const std::string& variant, TMetrics metrics)
+{
+    std::cout << "{\"bench\":\"" << name << "\",\"variant\":\"" << variant << "\"";
+    for (const auto& metric: metrics) {
+        std::cout << ",\"" << metric.first << "\":" << metric.second;
+    }
+    std::cout << "}" << std::endl;
+}
+
+uint64_t Bench::NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/* Usage: bench [name...]. Runs all benchmarks if no names given */
+int main(int argc, char* argv[])
+{
+    // results go to stdout, keep it clean from driver logs
+    Info.SetEnabled(false);
+    Warn.SetEnabled(false);
+
+    int status = 0;
+    if (argc < 2) {
+        for (const auto& bench: GetBenches()) {
+            bench.second();
+        }
+        return status;
+    }
+    for (int i = 1; i < argc; ++i) {
+        auto it = GetBenches().find(argv[i]);
+        if (it == GetBenches().end()) {
+            std::cerr << "Unknown benchmark: " << argv[i] << std::endl;
+            status = 1;
+            continue;
+        }
+        it->second();
+    }
+    return status;
+}
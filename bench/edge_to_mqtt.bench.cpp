@@ -0,0 +1,210 @@
+#include "bench.h"
+#include "config.h"
+#include "gpio_driver.h"
+#include "latency_histogram.h"
+#include "simulated_gpio_backend.h"
+
+#include <wblib/wbmqtt.h>
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+
+/* End-to-end latency from a GPIO edge to its MQTT publish. The real TGpioDriver with its
+   MQTT driver runs over simulated chips (see src/simulated_gpio_backend.h) against a local broker,
+   e.g. "mosquitto -p 1883". A second MQTT client subscribes to controls of the driver's device
+   and timestamps the arrival of the new value of every edge. Edges are driven one at a time,
+   so every sample is the latency of an idle driver, queueing is measured by other benchmarks.
+   Sweeps line count and debounce: userspace 0, 1 and 10 ms and kernel 1 ms.
+   Broker is taken from BENCH_MQTT_HOST and BENCH_MQTT_PORT (localhost:1883 by default), the benchmark
+   is skipped if it is not reachable. The broker must not be used by another wb-gpio driver */
+namespace
+{
+    const size_t EDGES = 200;
+    const uint32_t MAX_LINES_PER_CHIP = 50;
+    const auto PUBLISH_TIMEOUT = std::chrono::seconds(2);
+    const auto CONTROLS_TOPIC = std::string("/devices/") + TGpioDriver::Name + "/controls/";
+
+    struct TDebounceSetting
+    {
+        const char* Name;
+        std::chrono::microseconds Timeout;
+        bool IsKernel;
+    };
+
+    /* Publish awaited by the bench thread, filled by the subscriber */
+    class TExpectedPublish
+    {
+        std::mutex Mutex;
+        std::condition_variable Received;
+        std::string Topic;
+        std::string Payload;
+        TTimePoint ReceiveTime;
+        bool IsReceived = true;
+
+    public:
+        void Expect(const std::string& topic, const std::string& payload)
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Topic = topic;
+            Payload = payload;
+            IsReceived = false;
+        }
+
+        void OnMessage(const WBMQTT::TMqttMessage& message)
+        {
+            auto now = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(Mutex);
+            if (!IsReceived && message.Topic == Topic && message.Payload == Payload) {
+                ReceiveTime = now;
+                IsReceived = true;
+                Received.notify_all();
+            }
+        }
+
+        /* Returns false on timeout */
+        bool Wait(TTimePoint& receiveTime)
+        {
+            std::unique_lock<std::mutex> lock(Mutex);
+            if (!Received.wait_for(lock, PUBLISH_TIMEOUT, [this] { return IsReceived; })) {
+                IsReceived = true; // late publish is not a sample of the next edge
+                return false;
+            }
+            receiveTime = ReceiveTime;
+            return true;
+        }
+    };
+
+    bool IsBrokerReachable(const WBMQTT::TMosquittoMqttConfig& config)
+    {
+        addrinfo hints{};
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(config.Host.c_str(), std::to_string(config.Port).c_str(), &hints, &addresses) != 0) {
+            return false;
+        }
+        bool isConnected = false;
+        for (auto address = addresses; address && !isConnected; address = address->ai_next) {
+            int fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (fd >= 0) {
+                isConnected = (connect(fd, address->ai_addr, address->ai_addrlen) == 0);
+                close(fd);
+            }
+        }
+        freeaddrinfo(addresses);
+        return isConnected;
+    }
+
+    std::string GetChipPath(uint32_t chip)
+    {
+        return "/dev/gpiochip" + std::to_string(100 + chip);
+    }
+
+    void RunSweepPoint(const WBMQTT::PDeviceDriver& mqttDriver,
+                       TExpectedPublish& expected,
+                       uint32_t lineCount,
+                       const TDebounceSetting& debounce)
+    {
+        auto backend = std::make_shared<TSimulatedGpioBackend>();
+        TGpioDriverConfig config;
+        config.DeviceName = "GPIO latency bench";
+
+        for (uint32_t line = 0; line < lineCount; ++line) {
+            auto chip = line / MAX_LINES_PER_CHIP;
+            if (chip == config.Chips.size()) {
+                TSimulatedGpioChipConfig simulatedChip;
+                simulatedChip.Path = GetChipPath(chip);
+                simulatedChip.LineCount = MAX_LINES_PER_CHIP;
+                backend->AddChip(simulatedChip);
+                config.Chips.emplace_back(simulatedChip.Path);
+            }
+            TGpioLineConfig lineConfig;
+            lineConfig.Offset = line % MAX_LINES_PER_CHIP;
+            lineConfig.Name = "in" + std::to_string(line);
+            lineConfig.Direction = EGpioDirection::Input;
+            lineConfig.DebounceTimeout = debounce.Timeout;
+            lineConfig.KernelDebounce = debounce.IsKernel;
+            config.Chips.back().Lines.push_back(lineConfig);
+        }
+
+        auto gpioDriver = std::make_unique<TGpioDriver>(mqttDriver, config, backend);
+        gpioDriver->Start();
+
+        Bench::TLatencyHistogram histogram;
+        size_t timeouts = 0;
+        std::vector<bool> levels(lineCount, false);
+        for (size_t edge = 0; edge < EDGES; ++edge) {
+            auto line = edge % lineCount;
+            levels[line] = !levels[line];
+            expected.Expect(CONTROLS_TOPIC + "in" + std::to_string(line), levels[line] ? "1" : "0");
+
+            auto edgeTime = std::chrono::steady_clock::now();
+            backend->SetLevel(GetChipPath(line / MAX_LINES_PER_CHIP), line % MAX_LINES_PER_CHIP, levels[line]);
+
+            TTimePoint receiveTime;
+            if (expected.Wait(receiveTime)) {
+                histogram.Add(receiveTime - edgeTime);
+            } else {
+                ++timeouts;
+            }
+        }
+        gpioDriver.reset();
+
+        Bench::Report("edge_to_mqtt",
+                      std::string(debounce.Name) + "_lines_" + std::to_string(lineCount),
+                      {{"lines", lineCount},
+                       {"debounce_us", static_cast<double>(debounce.Timeout.count())},
+                       {"samples", histogram.GetCount()},
+                       {"timeouts", timeouts},
+                       {"p50_us", histogram.GetPercentileUs(50)},
+                       {"p90_us", histogram.GetPercentileUs(90)},
+                       {"p99_us", histogram.GetPercentileUs(99)},
+                       {"max_us", histogram.GetMaxUs()}});
+    }
+}
+
+BENCH(edge_to_mqtt)
+{
+    WBMQTT::TMosquittoMqttConfig mqttConfig;
+    mqttConfig.Host = getenv("BENCH_MQTT_HOST") ? getenv("BENCH_MQTT_HOST") : "localhost";
+    mqttConfig.Port = getenv("BENCH_MQTT_PORT") ? std::stoi(getenv("BENCH_MQTT_PORT")) : 1883;
+    if (!IsBrokerReachable(mqttConfig)) {
+        std::cerr << "edge_to_mqtt: skipped, no MQTT broker at " << mqttConfig.Host << ":" << mqttConfig.Port
+                  << std::endl;
+        return;
+    }
+
+    TExpectedPublish expected;
+    mqttConfig.Id = "wb-mqtt-gpio-bench-subscriber";
+    auto subscriber = WBMQTT::NewMosquittoMqttClient(mqttConfig);
+    subscriber->Subscribe([&expected](const WBMQTT::TMqttMessage& message) { expected.OnMessage(message); },
+                          CONTROLS_TOPIC + "+");
+    subscriber->Start();
+
+    mqttConfig.Id = "wb-mqtt-gpio-bench";
+    auto mqttDriver = WBMQTT::NewDriver(WBMQTT::TDriverArgs{}
+                                            .SetBackend(WBMQTT::NewDriverBackend(WBMQTT::NewMosquittoMqttClient(mqttConfig)))
+                                            .SetId(mqttConfig.Id)
+                                            .SetReownUnknownDevices(true));
+    mqttDriver->StartLoop();
+    mqttDriver->WaitForReady();
+
+    const TDebounceSetting debounceSettings[] = {{"debounce_0ms", std::chrono::microseconds(0), false},
+                                                 {"debounce_1ms", std::chrono::microseconds(1000), false},
+                                                 {"debounce_10ms", std::chrono::microseconds(10000), false},
+                                                 {"kernel_debounce_1ms", std::chrono::microseconds(1000), true}};
+    for (uint32_t lineCount: {8u, 64u, 200u}) {
+        for (const auto& debounce: debounceSettings) {
+            RunSweepPoint(mqttDriver, expected, lineCount, debounce);
+        }
+    }
+
+    mqttDriver->StopLoop();
+    mqttDriver->Close();
+    subscriber->Stop();
+}
@@ -0,0 +1,93 @@
+#include "bench.h"
+#include "bench_gpio.h"
+#include "interruption_context.h"
+
+#include <sys/epoll.h>
+
+#include <memory>
+#include <unordered_map>
+
+/* Cost of routing ready epoll events to their lines: 8 chips with 200 interrupt lines in total.
+   "per_chip_lookup" replays the former dispatch: every chip driver looked up every ready fd
+   in its lines map and then in its timers map. "epoll_ptr" runs TGpioChipDriver::HandleInterrupt,
+   which takes the handler from epoll_event.data.ptr. Both variants drain the same events */
+namespace
+{
+    const size_t CHIPS = 8;
+    const size_t LINES = 200;
+    const size_t ROUNDS = 2000;
+    const int EPOLL_EVENT_COUNT = 20; // as in the GPIO worker
+
+    struct TChipFds
+    {
+        std::unordered_map<int, int> Lines;
+        std::unordered_map<int, int> Timers;
+    };
+
+    void LegacyDispatch(const std::vector<TChipFds>& chips, const TInterruptionContext& ctx)
+    {
+        for (const auto& chip: chips) {
+            for (int i = 0; i < ctx.Count; ++i) {
+                const auto* source = static_cast<const TEpollSource*>(ctx.Events[i].data.ptr);
+                if (chip.Lines.find(source->Fd) != chip.Lines.end()) {
+                    source->Handle(ctx);
+                } else if (chip.Timers.find(source->Fd) != chip.Timers.end()) {
+                    source->Handle(ctx);
+                }
+            }
+        }
+    }
+}
+
+BENCH(epoll_dispatch)
+{
+    std::vector<std::shared_ptr<Bench::TGpioChipDriver>> drivers;
+    std::vector<TChipFds> chips(CHIPS);
+    std::vector<Bench::TEventPipe> pipes(LINES);
+
+    int epfd = epoll_create(1);
+    for (size_t chip = 0; chip < CHIPS; ++chip) {
+        auto driver = std::make_shared<Bench::TGpioChipDriver>();
+        for (size_t i = chip; i < LINES; i += CHIPS) {
+            driver->AddInputLine(std::to_string(i), pipes[i].ReadFd);
+            chips[chip].Lines[pipes[i].ReadFd] = i;
+            chips[chip].Timers[-1 - static_cast<int>(i)] = i; // a timer per line
+        }
+        driver->AddToEpoll(epfd);
+        drivers.push_back(driver);
+    }
+
+    for (size_t readyLines: {1, 4, EPOLL_EVENT_COUNT}) {
+        for (bool legacy: {true, false}) {
+            uint64_t events = 0, elapsedNs = 0;
+            for (size_t round = 0; round < ROUNDS; ++round) {
+                for (size_t i = 0; i < readyLines; ++i) {
+                    pipes[(round * readyLines + i * 7) % LINES].WriteBurst(1);
+                }
+
+                struct epoll_event ready[EPOLL_EVENT_COUNT];
+                TInterruptionContext ctx(epoll_wait(epfd, ready, EPOLL_EVENT_COUNT, 0), ready);
+
+                auto start = Bench::NowNs();
+                if (legacy) {
+                    LegacyDispatch(chips, ctx);
+                } else {
+                    TGpioChipDriver::HandleInterrupt(ctx);
+                }
+                elapsedNs += Bench::NowNs() - start;
+                events += ctx.Count;
+            }
+            Bench::Report("epoll_dispatch",
+                          legacy ? "per_chip_lookup" : "epoll_ptr",
+                          {{"chips", CHIPS},
+                           {"lines", LINES},
+                           {"ready_lines", readyLines},
+                           {"ns_per_event", static_cast<double>(elapsedNs) / events}});
+        }
+    }
+
+    close(epfd);
+    for (const auto& eventPipe: pipes) {
+        close(eventPipe.WriteFd);
+    }
+}
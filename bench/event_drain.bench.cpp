@@ -0,0 +1,92 @@
+#include "bench.h"
+#include "bench_gpio.h"
+#include "interruption_context.h"
+#include "syscall_counter.h"
+
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+
+/* Syscalls and time spent per line edge when a burst of uAPI v1 events is drained.
+   A pipe stands in for the line event fd: it delivers the same gpioevent_data records.
+   "select_read_ioctl" replays the former per-event loop (FIONREAD plays the role of
+   GPIOHANDLE_GET_LINE_VALUES_IOCTL, which pipes do not support), "batched_read" runs
+   TGpioChipDriver::HandleInterrupt */
+namespace
+{
+    const size_t ROUNDS = 200;
+
+    size_t LegacyDrain(int fd)
+    {
+        size_t handled = 0;
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(fd, &rfds);
+        struct timeval tv{0};
+
+        while (select(fd + 1, &rfds, nullptr, nullptr, &tv) > 0) {
+            gpioevent_data data{};
+            if (read(fd, &data, sizeof(data)) <= 0) {
+                break;
+            }
+            int pending;
+            ioctl(fd, FIONREAD, &pending);
+            ++handled;
+        }
+        return handled;
+    }
+
+    void Report(const char* variant, size_t edges, uint64_t syscalls, uint64_t elapsedNs)
+    {
+        double total = edges * ROUNDS;
+        Bench::Report("event_drain",
+                      variant,
+                      {{"edges_per_burst", edges},
+                       {"syscalls_per_edge", syscalls / total},
+                       {"ns_per_edge", elapsedNs / total}});
+    }
+}
+
+BENCH(event_drain)
+{
+    for (size_t edges: {1, 8, 64, 256}) {
+        {
+            Bench::TEventPipe eventPipe;
+            uint64_t syscalls = 0, elapsedNs = 0;
+            for (size_t round = 0; round < ROUNDS; ++round) {
+                eventPipe.WriteBurst(edges);
+                ResetSyscallCounters();
+                auto start = Bench::NowNs();
+                LegacyDrain(eventPipe.ReadFd);
+                elapsedNs += Bench::NowNs() - start;
+                syscalls += GetSyscallCounters().Total();
+            }
+            Report("select_read_ioctl", edges, syscalls, elapsedNs);
+            close(eventPipe.ReadFd);
+            close(eventPipe.WriteFd);
+        }
+        {
+            Bench::TEventPipe eventPipe;
+            auto driver = std::make_shared<Bench::TGpioChipDriver>();
+            driver->AddInputLine("bench", eventPipe.ReadFd);
+
+            int epfd = epoll_create(1);
+            driver->AddToEpoll(epfd);
+
+            uint64_t syscalls = 0, elapsedNs = 0;
+            for (size_t round = 0; round < ROUNDS; ++round) {
+                eventPipe.WriteBurst(edges);
+                struct epoll_event events[2];
+                TInterruptionContext ctx(epoll_wait(epfd, events, 2, -1), events);
+                ResetSyscallCounters();
+                auto start = Bench::NowNs();
+                TGpioChipDriver::HandleInterrupt(ctx);
+                elapsedNs += Bench::NowNs() - start;
+                syscalls += GetSyscallCounters().Total();
+            }
+            Report("batched_read", edges, syscalls, elapsedNs);
+            close(epfd);
+            close(eventPipe.WriteFd);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#include "bench.h"
+#include "config.h"
+#include "gpio_counter.h"
+#include "utils.h"
+
+#include <chrono>
+
+/* Costs of counter paths hit per edge and per publish: TGpioCounter::HandleInterrupt() counts an edge,
+   Update() decays current value, GetIdsAndValues() formats values of counter controls.
+   Utils::SetDecimalPlaces() is the formatting used by the latter, measured for several precisions */
+namespace
+{
+    const size_t ITERATIONS = 1000000;
+    const size_t FORMAT_ITERATIONS = 200000;
+
+    TGpioLineConfig MakeCounterConfig()
+    {
+        TGpioLineConfig config;
+        config.Name = "meter";
+        config.Direction = EGpioDirection::Input;
+        config.Type = "water_meter";
+        config.InterruptEdge = EGpioEdge::RISING;
+        return config;
+    }
+}
+
+BENCH(gpio_counter)
+{
+    TGpioCounter counter(MakeCounterConfig());
+    const auto interval = std::chrono::microseconds(100000);
+
+    auto ns = Bench::MeasureNsPerCall(ITERATIONS, [&](size_t i) {
+        counter.HandleInterrupt(EGpioEdge::RISING, interval + std::chrono::microseconds(i % 64));
+    });
+    Bench::Report("gpio_counter", "handle_interrupt", {{"ns_per_call", ns}});
+
+    ns = Bench::MeasureNsPerCall(ITERATIONS, [&](size_t i) {
+        // re-arm current value now and then, so the decay does not stop at zero
+        if (i % 16 == 0) {
+            counter.HandleInterrupt(EGpioEdge::RISING, interval);
+        }
+        counter.Update(interval * (2 + i % 16));
+    });
+    Bench::Report("gpio_counter", "update", {{"ns_per_call", ns}});
+
+    counter.HandleInterrupt(EGpioEdge::RISING, interval);
+    ns = Bench::MeasureNsPerCall(FORMAT_ITERATIONS, [&](size_t) {
+        auto idsAndValues = counter.GetIdsAndValues("meter");
+        Bench::DoNotOptimize(idsAndValues);
+    });
+    Bench::Report("gpio_counter", "get_ids_and_values", {{"ns_per_call", ns}});
+}
+
+BENCH(decimal_places)
+{
+    for (int decimalPlaces: {0, 2, DEFAULT_DECIMAL_PLACES}) {
+        auto ns = Bench::MeasureNsPerCall(FORMAT_ITERATIONS, [&](size_t i) {
+            auto value = Utils::SetDecimalPlaces(123.456f + i, decimalPlaces);
+            Bench::DoNotOptimize(value);
+        });
+        Bench::Report("decimal_places", "places_" + std::to_string(decimalPlaces), {{"ns_per_call", ns}});
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace Bench
+{
+    /* Latency samples of a run and their percentiles */
+    class TLatencyHistogram
+    {
+        std::vector<uint64_t> SamplesNs;
+        bool IsSorted = true;
+
+    public:
+        void Add(const std::chrono::nanoseconds& latency)
+        {
+            SamplesNs.push_back(std::max<int64_t>(latency.count(), 0));
+            IsSorted = false;
+        }
+
+        size_t GetCount() const
+        {
+            return SamplesNs.size();
+        }
+
+        /* Nearest-rank percentile in microseconds, 0 if there are no samples */
+        double GetPercentileUs(double percentile)
+        {
+            if (SamplesNs.empty()) {
+                return 0;
+            }
+            if (!IsSorted) {
+                std::sort(SamplesNs.begin(), SamplesNs.end());
+                IsSorted = true;
+            }
+            auto rank = static_cast<size_t>(percentile / 100 * SamplesNs.size());
+            return SamplesNs[std::min(rank, SamplesNs.size() - 1)] / 1000.0;
+        }
+
+        double GetMaxUs()
+        {
+            return GetPercentileUs(100);
+        }
+    };
+}
@@ -0,0 +1,51 @@
+#include "bench.h"
+#include "bench_gpio.h"
+
+#include <chrono>
+
+/* Cost of TGpioLine::UpdateIfStable(), called by the debounce timer of every edge.
+   "in_window" is the check of a line that got a new edge within debounce window,
+   "commit" settles a new level, "commit_counter" also counts the edge by the line's counter */
+namespace
+{
+    const size_t ITERATIONS = 1000000;
+    const auto DEBOUNCE = std::chrono::microseconds(1000);
+
+    PGpioLine MakeLine(bool isCounter)
+    {
+        TGpioLineConfig config;
+        config.Name = "line";
+        config.Direction = EGpioDirection::Input;
+        config.DebounceTimeout = DEBOUNCE;
+        if (isCounter) {
+            config.Type = "water_meter";
+            config.InterruptEdge = EGpioEdge::RISING;
+        }
+        return std::make_shared<Bench::TGpioLine>(config);
+    }
+}
+
+BENCH(line_debounce)
+{
+    auto start = TTimePoint() + std::chrono::hours(1);
+
+    auto line = MakeLine(false);
+    line->HandleInterrupt(start);
+    auto ns = Bench::MeasureNsPerCall(ITERATIONS, [&](size_t i) {
+        Bench::DoNotOptimize(line->UpdateIfStable(start + DEBOUNCE / 2));
+    });
+    Bench::Report("line_debounce", "in_window", {{"ns_per_call", ns}});
+
+    for (bool isCounter: {false, true}) {
+        line = MakeLine(isCounter);
+        ns = Bench::MeasureNsPerCall(ITERATIONS, [&](size_t i) {
+            // every edge is settled 2 debounce windows later, then the line waits for the next one
+            auto edgeTime = start + DEBOUNCE * 4 * i;
+            line->SetCachedValueUnfiltered(i % 2);
+            line->HandleInterrupt(edgeTime);
+            Bench::DoNotOptimize(line->UpdateIfStable(edgeTime + DEBOUNCE * 2));
+            line->ClearDirty();
+        });
+        Bench::Report("line_debounce", isCounter ? "commit_counter" : "commit", {{"ns_per_call", ns}});
+    }
+}
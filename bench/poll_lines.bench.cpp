@@ -0,0 +1,66 @@
+#include "bench.h"
+#include "config.h"
+#include "gpio_chip_driver.h"
+#include "simulated_gpio_backend.h"
+
+#include <memory>
+
+/* Readback of 64 interrupt inputs by TGpioChipDriver::PollLines() on a simulated chip
+   (see src/simulated_gpio_backend.h). With uAPI v2 all lines are read by PollLinesValues()
+   as a single 64-line bulk, "uapi_v1" reads them by a request per line.
+   "stable" reads unchanged values, "changing" flips every other line between rounds */
+namespace
+{
+    const uint32_t LINES = 64;
+    const size_t ROUNDS = 20000;
+    const auto CHIP_PATH = "/dev/gpiochip100";
+
+    void RunPollLines(bool isUapiV2, bool isChanging)
+    {
+        auto backend = std::make_shared<TSimulatedGpioBackend>();
+        TSimulatedGpioChipConfig simulatedChip;
+        simulatedChip.Path = CHIP_PATH;
+        simulatedChip.LineCount = LINES;
+        simulatedChip.UapiV2Supported = isUapiV2;
+        backend->AddChip(simulatedChip);
+
+        TGpioChipConfig chipConfig(CHIP_PATH);
+        for (uint32_t i = 0; i < LINES; ++i) {
+            TGpioLineConfig lineConfig;
+            lineConfig.Offset = i;
+            lineConfig.Name = "line" + std::to_string(i);
+            lineConfig.Direction = EGpioDirection::Input;
+            chipConfig.Lines.push_back(lineConfig);
+        }
+        TGpioChipDriver driver(chipConfig, backend);
+
+        uint64_t elapsedNs = 0;
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            if (isChanging) {
+                // nobody reads events here, so the simulated chip drops them once pipes are full
+                for (uint32_t i = 0; i < LINES; i += 2) {
+                    backend->SetLevel(CHIP_PATH, i, round % 2);
+                }
+            }
+            auto start = Bench::NowNs();
+            Bench::DoNotOptimize(driver.PollLines());
+            elapsedNs += Bench::NowNs() - start;
+            driver.ForEachDirtyLine([](const PGpioLine&) {});
+        }
+
+        Bench::Report("poll_lines",
+                      std::string(isUapiV2 ? "uapi_v2" : "uapi_v1") + (isChanging ? "_changing" : "_stable"),
+                      {{"lines", LINES},
+                       {"ns_per_round", static_cast<double>(elapsedNs) / ROUNDS},
+                       {"ns_per_line", static_cast<double>(elapsedNs) / ROUNDS / LINES}});
+    }
+}
+
+BENCH(poll_lines)
+{
+    for (bool isUapiV2: {true, false}) {
+        for (bool isChanging: {false, true}) {
+            RunPollLines(isUapiV2, isChanging);
+        }
+    }
+}
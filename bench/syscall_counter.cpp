@@ -0,0 +1,44 @@
+#include "syscall_counter.h"
+
+#include <sys/select.h>
+#include <sys/types.h>
+
+namespace
+{
+    TSyscallCounters Counters;
+}
+
+extern "C"
+{
+    ssize_t __real_read(int fd, void* buf, size_t count);
+    int __real_select(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds, struct timeval* timeout);
+    int __real_ioctl(int fd, unsigned long request, void* arg);
+
+    ssize_t __wrap_read(int fd, void* buf, size_t count)
+    {
+        ++Counters.Read;
+        return __real_read(fd, buf, count);
+    }
+
+    int __wrap_select(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds, struct timeval* timeout)
+    {
+        ++Counters.Select;
+        return __real_select(nfds, readfds, writefds, exceptfds, timeout);
+    }
+
+    int __wrap_ioctl(int fd, unsigned long request, void* arg)
+    {
+        ++Counters.Ioctl;
+        return __real_ioctl(fd, request, arg);
+    }
+}
+
+TSyscallCounters GetSyscallCounters()
+{
+    return Counters;
+}
+
+void ResetSyscallCounters()
+{
+    Counters = TSyscallCounters();
+}
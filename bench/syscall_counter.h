@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+/* Counts syscalls issued by the linked code. The bench binary is linked with
+   -Wl,--wrap=read,--wrap=select,--wrap=ioctl, so calls from src/ objects go through the counters */
+struct TSyscallCounters
+{
+    uint64_t Read = 0;
+    uint64_t Select = 0;
+    uint64_t Ioctl = 0;
+
+    uint64_t Total() const
+    {
+        return Read + Select + Ioctl;
+    }
+};
+
+TSyscallCounters GetSyscallCounters();
+void ResetSyscallCounters();
@@ -0,0 +1,86 @@
+#include "bench.h"
+#include "config.h"
+#include "gpio_chip_driver.h"
+#include "gpio_lane.h"
+#include "publish_queue.h"
+#include "simulated_gpio_backend.h"
+
+#include <poll.h>
+
+#include <memory>
+#include <vector>
+
+/* Full worker loop of a lane over 200 inputs on 4 simulated chips (see src/simulated_gpio_backend.h):
+   a round toggles the given number of lines, the lane worker wakes up, dispatches events,
+   commits values (debounced by kernel, so without timers) and passes changes to the publish queue.
+   The queue stands in for MQTT driver: bench thread drains it like the publisher thread does
+   before turning updates into a transaction. A round ends when updates of all toggled lines are drained */
+namespace
+{
+    const uint32_t CHIPS = 4;
+    const uint32_t LINES_PER_CHIP = 50;
+    const size_t ROUNDS = 2000;
+
+    std::string GetChipPath(uint32_t chip)
+    {
+        return "/dev/gpiochip" + std::to_string(100 + chip);
+    }
+}
+
+BENCH(worker_loop)
+{
+    auto backend = std::make_shared<TSimulatedGpioBackend>();
+    TGpioDriverConfig driverConfig;
+    driverConfig.PublishParameters.Policy = WBMQTT::TPublishParameters::PublishOnlyOnChange;
+
+    TPublishQueue queue;
+    TGpioLane lane(TGpioLane::MAIN, nullptr, driverConfig);
+    lane.SetPublishQueue(&queue);
+
+    for (uint32_t chip = 0; chip < CHIPS; ++chip) {
+        TSimulatedGpioChipConfig simulatedChip;
+        simulatedChip.Path = GetChipPath(chip);
+        simulatedChip.LineCount = LINES_PER_CHIP;
+        backend->AddChip(simulatedChip);
+
+        TGpioChipConfig chipConfig(simulatedChip.Path);
+        for (uint32_t i = 0; i < LINES_PER_CHIP; ++i) {
+            TGpioLineConfig lineConfig;
+            lineConfig.Offset = i;
+            lineConfig.Name = std::to_string(chip) + "_" + std::to_string(i);
+            lineConfig.Direction = EGpioDirection::Input;
+            lineConfig.KernelDebounce = true;
+            chipConfig.Lines.push_back(lineConfig);
+        }
+        lane.AddChipDriver(std::make_shared<TGpioChipDriver>(chipConfig, backend));
+    }
+    lane.Start();
+
+    pollfd queueFd{queue.GetFd(), POLLIN, 0};
+    for (uint32_t toggledLines: {1u, 20u, CHIPS * LINES_PER_CHIP}) {
+        uint64_t elapsedNs = 0;
+        size_t published = 0;
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            auto start = Bench::NowNs();
+            for (uint32_t i = 0; i < toggledLines; ++i) {
+                backend->Toggle(GetChipPath(i % CHIPS), i / CHIPS);
+            }
+            size_t updates = 0;
+            while (updates < toggledLines) {
+                poll(&queueFd, 1, 1000);
+                queue.Drain([&updates](const TControlUpdates& batch) { updates += batch.size(); });
+            }
+            elapsedNs += Bench::NowNs() - start;
+            published += updates;
+        }
+
+        Bench::Report("worker_loop",
+                      "toggled_" + std::to_string(toggledLines),
+                      {{"lines", CHIPS * LINES_PER_CHIP},
+                       {"toggled_lines", toggledLines},
+                       {"us_per_round", static_cast<double>(elapsedNs) / ROUNDS / 1000},
+                       {"ns_per_update", static_cast<double>(elapsedNs) / published},
+                       {"dropped_events", static_cast<double>(backend->GetDroppedEventCount())}});
+    }
+    lane.Stop();
+}
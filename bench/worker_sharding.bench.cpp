@@ -0,0 +1,150 @@
+#include "bench.h"
+#include "bench_gpio.h"
+#include "interruption_context.h"
+#include "publish_queue.h"
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/* Edge throughput of chip drivers sharded across 1 to 4 worker threads. 8 simulated chips
+   (pipes, see bench_gpio.h) with 8 lines each get a burst of edges per line. Every worker
+   runs the lane loop over its own epoll set: dispatches events, commits values of lines
+   (debounced by kernel, so without timers) and passes changed lines to the shared publish queue, drained by a publisher thread.
+   Workers can only scale up to the number of free cores, "cpus" reports it */
+namespace
+{
+    const size_t CHIPS = 8;
+    const size_t LINES_PER_CHIP = 8;
+    const size_t EDGES_PER_LINE = 512; // 8 KiB of events, fits into pipe buffer
+    const size_t ROUNDS = 20;
+    const int EPOLL_EVENT_COUNT = 20; // as in lane worker
+
+    struct TShard
+    {
+        std::vector<std::shared_ptr<Bench::TGpioChipDriver>> Drivers;
+        std::vector<int> EventFds;
+        int Epfd = -1;
+    };
+
+    bool IsDrained(const TShard& shard)
+    {
+        for (auto fd: shard.EventFds) {
+            int pending = 0;
+            if (ioctl(fd, FIONREAD, &pending) == 0 && pending > 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void RunWorker(TShard& shard, TPublishQueue& queue)
+    {
+        struct epoll_event events[EPOLL_EVENT_COUNT];
+        TControlUpdates updates;
+        auto collect = [&updates](const PGpioLine& line) { AppendControlUpdates(line, updates); };
+
+        for (;;) {
+            int count = epoll_wait(shard.Epfd, events, EPOLL_EVENT_COUNT, 0);
+            if (count > 0) {
+                TInterruptionContext ctx(count, events);
+                TGpioChipDriver::HandleInterrupt(ctx);
+            }
+            for (const auto& driver: shard.Drivers) {
+                driver->ForEachDirtyLine(collect);
+            }
+            if (!updates.empty()) {
+                queue.Push(std::move(updates));
+                updates.clear();
+            }
+            if (count <= 0 && IsDrained(shard)) {
+                return;
+            }
+        }
+    }
+}
+
+BENCH(worker_sharding)
+{
+    double singleWorkerRate = 0;
+    for (size_t workers = 1; workers <= 4; ++workers) {
+        std::vector<Bench::TEventPipe> pipes(CHIPS * LINES_PER_CHIP);
+        std::vector<TShard> shards(workers);
+
+        for (size_t chip = 0; chip < CHIPS; ++chip) {
+            auto driver = std::make_shared<Bench::TGpioChipDriver>();
+            auto& shard = shards[chip % workers];
+            for (size_t i = 0; i < LINES_PER_CHIP; ++i) {
+                const auto& eventPipe = pipes[chip * LINES_PER_CHIP + i];
+                auto line = driver->AddInputLine(std::to_string(chip) + "_" + std::to_string(i), eventPipe.ReadFd);
+                line->SetDebouncedByKernel(true); // every edge is committed and published at once
+                shard.EventFds.push_back(eventPipe.ReadFd);
+            }
+            shard.Drivers.push_back(driver);
+        }
+        for (auto& shard: shards) {
+            shard.Epfd = epoll_create(1);
+            for (const auto& driver: shard.Drivers) {
+                driver->AddToEpoll(shard.Epfd);
+            }
+        }
+
+        TPublishQueue queue;
+        std::atomic_bool publishing{true};
+        size_t published = 0;
+        std::thread publisher([&] {
+            auto count = [&published](const TControlUpdates& batch) { published += batch.size(); };
+            pollfd queueFd{queue.GetFd(), POLLIN, 0};
+            while (publishing) {
+                poll(&queueFd, 1, 1);
+                queue.Drain(count);
+            }
+            queue.Drain(count);
+        });
+
+        uint64_t elapsedNs = 0;
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            for (auto& eventPipe: pipes) {
+                eventPipe.WriteBurst(EDGES_PER_LINE);
+            }
+
+            // thread start is measured too, it is small compared to the burst
+            auto start = Bench::NowNs();
+            std::vector<std::thread> threads;
+            for (auto& shard: shards) {
+                threads.emplace_back(RunWorker, std::ref(shard), std::ref(queue));
+            }
+            for (auto& thread: threads) {
+                thread.join();
+            }
+            elapsedNs += Bench::NowNs() - start;
+        }
+
+        publishing = false;
+        publisher.join();
+
+        double edgesPerMs = static_cast<double>(CHIPS * LINES_PER_CHIP * EDGES_PER_LINE * ROUNDS) / elapsedNs * 1e6;
+        if (workers == 1) {
+            singleWorkerRate = edgesPerMs;
+        }
+        Bench::Report("worker_sharding",
+                      "workers_" + std::to_string(workers),
+                      {{"workers", workers},
+                       {"cpus", std::thread::hardware_concurrency()},
+                       {"edges_per_ms", edgesPerMs},
+                       {"speedup", edgesPerMs / singleWorkerRate},
+                       {"published_per_round", static_cast<double>(published) / ROUNDS}});
+
+        for (auto& shard: shards) {
+            close(shard.Epfd);
+        }
+        for (const auto& eventPipe: pipes) {
+            close(eventPipe.WriteFd);
+        }
+    }
+}
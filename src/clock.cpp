@@ -0,0 +1,68 @@
+#include "clock.h"
+
+#include <cassert>
+
+using namespace std;
+
+namespace
+{
+    // realtime of simulated clock is fixed, 2020-01-01 at its zero time point
+    const auto SIMULATED_REALTIME_OFFSET = chrono::seconds(1577836800);
+
+    class TSteadyClock: public TClock
+    {
+    public:
+        TTimePoint Now() const override
+        {
+            return chrono::steady_clock::now();
+        }
+
+        chrono::nanoseconds GetRealtimeOffset() const override
+        {
+            return chrono::system_clock::now().time_since_epoch() - chrono::steady_clock::now().time_since_epoch();
+        }
+
+        bool IsSimulated() const override
+        {
+            return false;
+        }
+    };
+}
+
+const PClock& GetSteadyClock()
+{
+    static const PClock clock = make_shared<TSteadyClock>();
+    return clock;
+}
+
+TSimulatedClock::TSimulatedClock(const TTimePoint& start)
+    : TimeNs(chrono::duration_cast<chrono::nanoseconds>(start.time_since_epoch()).count())
+{}
+
+TTimePoint TSimulatedClock::Now() const
+{
+    return TTimePoint(chrono::nanoseconds(TimeNs.load()));
+}
+
+chrono::nanoseconds TSimulatedClock::GetRealtimeOffset() const
+{
+    return SIMULATED_REALTIME_OFFSET;
+}
+
+bool TSimulatedClock::IsSimulated() const
+{
+    return true;
+}
+
+void TSimulatedClock::SetTime(const TTimePoint& time)
+{
+    auto timeNs = chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch()).count();
+    assert(timeNs >= TimeNs.load());
+    TimeNs = timeNs;
+}
+
+void TSimulatedClock::Advance(const chrono::nanoseconds& interval)
+{
+    assert(interval.count() >= 0);
+    TimeNs += interval.count();
+}
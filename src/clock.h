@@ -0,0 +1,47 @@
+#pragma once
+
+#include "declarations.h"
+
+#include <atomic>
+
+/**
+ * @brief Source of time of chip drivers: time of line events, debounce and counter deadlines, poll schedule.
+ *        Steady clock in production, simulated clock lets tests and benchmarks run in virtual time.
+ */
+class TClock
+{
+public:
+    virtual ~TClock() = default;
+
+    virtual TTimePoint Now() const = 0;
+
+    /* CLOCK_REALTIME minus Now(), converts timestamps of uAPI v1 events on kernels older than 5.7 */
+    virtual std::chrono::nanoseconds GetRealtimeOffset() const = 0;
+
+    /* Time of simulated clock moves only when its owner advances it. Timerfds are not armed for it,
+       the owner handles expired deadlines by TGpioChipDriver::HandleTimers() */
+    virtual bool IsSimulated() const = 0;
+};
+
+/* std::chrono::steady_clock, shared by all chip drivers */
+const PClock& GetSteadyClock();
+
+/* Virtual time set by its owner. Thread-safe */
+class TSimulatedClock: public TClock
+{
+    std::atomic<int64_t> TimeNs;
+
+public:
+    /* Starts far from zero time point, so the first event is not mistaken for the initial state of line */
+    explicit TSimulatedClock(const TTimePoint& start = TTimePoint(std::chrono::hours(1)));
+
+    TTimePoint Now() const override;
+    std::chrono::nanoseconds GetRealtimeOffset() const override;
+    bool IsSimulated() const override;
+
+    /* Time must not go back */
+    void SetTime(const TTimePoint& time);
+    void Advance(const std::chrono::nanoseconds& interval);
+};
+
+using PSimulatedClock = std::shared_ptr<TSimulatedClock>;
@@ -47,6 +47,13 @@ namespace
         chipConfig->Lines.push_back(line);
     }
 
+    void GetPollConfig(const Json::Value& settings, TGpioPollConfig& pollConfig)
+    {
+        Get(settings, "poll_interval", pollConfig.Interval);
+        Get(settings, "fast_poll_interval", pollConfig.FastInterval);
+        Get(settings, "fast_poll_hold", pollConfig.FastHold);
+    }
+
     TGpioDriverConfig LoadFromJSON(const Json::Value& root)
     {
         TGpioDriverConfig cfg;
@@ -62,6 +69,11 @@ namespace
         Get(root, "max_unchanged_interval", maxUnchangedInterval);
         cfg.PublishParameters.Set(maxUnchangedInterval);
 
+        Get(root, "worker_priority", cfg.WorkerPriority);
+        Get(root, "worker_cpu", cfg.WorkerCpu);
+        Get(root, "worker_threads", cfg.WorkerThreads);
+        Get(root, "lock_memory", cfg.LockMemory);
+
         for (const auto& channel: channels) {
             if (!channel.isMember("gpio")) {
                 LOG(Warn) << "Skip GPIO \"" << channel["name"].asString()
@@ -97,6 +109,38 @@ namespace
             Get(channel, "initial_state", lineConfig.InitialState);
             Get(channel, "load_previous_state", lineConfig.LoadPreviousState);
             Get(channel, "debounce", lineConfig.DebounceTimeout);
+            Get(channel, "debounce_rising", lineConfig.DebounceTimeoutRising);
+            Get(channel, "debounce_falling", lineConfig.DebounceTimeoutFalling);
+            Get(channel, "kernel_debounce", lineConfig.KernelDebounce);
+            if (channel.isMember("debounce_algorithm")) {
+                EnumerateDebounceAlgorithm(channel["debounce_algorithm"].asString(), lineConfig.DebounceAlgorithm);
+            }
+            Get(channel, "debounce_samples", lineConfig.DebounceSamples);
+            if (!Get(channel, "debounce_votes", lineConfig.DebounceVotes)) {
+                lineConfig.DebounceVotes = lineConfig.DebounceSamples / 2 + 1;
+            }
+            if (lineConfig.DebounceSamples < 1 || lineConfig.DebounceSamples > 64 ||
+                (lineConfig.DebounceAlgorithm == EDebounceAlgorithm::MAJORITY &&
+                 (lineConfig.DebounceVotes <= lineConfig.DebounceSamples / 2 ||
+                  lineConfig.DebounceVotes > lineConfig.DebounceSamples)))
+            {
+                wb_throw(TGpioDriverException,
+                         "bad debounce samples of GPIO \"" + lineConfig.Name +
+                             "\": debounce_samples must be 1-64 and debounce_votes must be a majority of them");
+            }
+            if (lineConfig.KernelDebounce) {
+                if (lineConfig.DebounceAlgorithm != EDebounceAlgorithm::WINDOW) {
+                    LOG(Warn) << "Kernel debounce of GPIO \"" << lineConfig.Name << "\" is not used with \""
+                              << DebounceAlgorithmToString(lineConfig.DebounceAlgorithm) << "\" debounce algorithm";
+                    lineConfig.KernelDebounce = false;
+                } else if (GetDebounceTimeout(lineConfig, true) != GetDebounceTimeout(lineConfig, false)) {
+                    LOG(Warn) << "Kernel debounce of GPIO \"" << lineConfig.Name
+                              << "\" is not used: kernel can't debounce rising and falling edges separately";
+                    lineConfig.KernelDebounce = false;
+                }
+            }
+            Get(channel, "readback", lineConfig.Readback);
+            Get(channel, "max_edge_rate", lineConfig.MaxEdgeRate);
 
             if (channel.isMember("direction") && channel["direction"].asString() == "input")
                 lineConfig.Direction = EGpioDirection::Input;
@@ -113,6 +157,23 @@ namespace
 
             AppendLine(cfg, path, lineConfig);
         }
+
+        TGpioPollConfig pollConfig;
+        GetPollConfig(root, pollConfig);
+        for (auto& chipConfig: cfg.Chips) {
+            chipConfig.Poll = pollConfig;
+        }
+        for (const auto& chip: root["chips"]) {
+            auto path = chip["path"].asString();
+            auto chipConfig =
+                find_if(cfg.Chips.begin(), cfg.Chips.end(), [&](const auto& c) { return c.Path == path; });
+            if (chipConfig == cfg.Chips.end()) {
+                LOG(Warn) << "Settings of chip \"" << path << "\" are not used, it has no channels";
+                continue;
+            }
+            GetPollConfig(chip, chipConfig->Poll);
+            Get(chip, "lane", chipConfig->Lane);
+        }
         return cfg;
     }
 
@@ -183,6 +244,12 @@ namespace
     }
 } // namespace
 
+std::chrono::microseconds GetDebounceTimeout(const TGpioLineConfig& config, bool level)
+{
+    const auto& timeout = level ? config.DebounceTimeoutRising : config.DebounceTimeoutFalling;
+    return (timeout.count() < 0) ? config.DebounceTimeout : timeout;
+}
+
 TGpioDriverConfig LoadConfig(const std::string& mainConfigFile,
                              const std::string& optionalConfigFile,
                              const std::string& systemConfigsDir,
@@ -6,6 +6,9 @@
 #include <wblib/driver_args.h>
 
 const int DEFAULT_DECIMAL_PLACES = 3;
+const auto DEFAULT_POLL_INTERVAL = std::chrono::milliseconds(500);
+const auto DEFAULT_FAST_POLL_HOLD = std::chrono::milliseconds(1000);
+const uint32_t DEFAULT_MAX_EDGE_RATE = 0; // no limit: storm protection is opt-in, so fast counters are not polled silently
 
 enum class EGpioDirection
 {
@@ -29,14 +32,36 @@ struct TGpioLineConfig
     bool InitialState = false;
     bool LoadPreviousState = true;
     std::chrono::microseconds DebounceTimeout = std::chrono::microseconds(10000);
+    // time to hold logical 1 (rising) or 0 (falling) before commit, negative - DebounceTimeout
+    std::chrono::microseconds DebounceTimeoutRising = std::chrono::microseconds(-1);
+    std::chrono::microseconds DebounceTimeoutFalling = std::chrono::microseconds(-1);
+    EDebounceAlgorithm DebounceAlgorithm = EDebounceAlgorithm::WINDOW;
+    uint32_t DebounceSamples = 5; // samples per debounce time of integrator and majority algorithms, 1-64
+    uint32_t DebounceVotes = 3;   // samples to agree on a level for majority algorithm
+    bool KernelDebounce = false; // pass DebounceTimeout to kernel with line request (uAPI v2)
+    bool Readback = true;        // periodically read interrupt input or output to detect disconnection
+    uint32_t MaxEdgeRate = DEFAULT_MAX_EDGE_RATE; // edges per second, above it the line is polled for a while, 0 - no limit
 };
 
 using TLinesConfig = std::vector<TGpioLineConfig>;
 
+/* Time logical level must be held to be committed by userspace debounce */
+std::chrono::microseconds GetDebounceTimeout(const TGpioLineConfig& config, bool level);
+
+/* Reading of inputs without interrupts */
+struct TGpioPollConfig
+{
+    std::chrono::milliseconds Interval = DEFAULT_POLL_INTERVAL;
+    std::chrono::milliseconds FastInterval = std::chrono::milliseconds::zero(); // after a change, 0 - disabled
+    std::chrono::milliseconds FastHold = DEFAULT_FAST_POLL_HOLD; // time since last change to keep fast rate
+};
+
 struct TGpioChipConfig
 {
     std::string Path;
     TLinesConfig Lines;
+    TGpioPollConfig Poll;
+    std::string Lane; // name of worker lane, empty - select by measured latency of the chip
 
     TGpioChipConfig(const std::string& path): Path(path)
     {}
@@ -48,6 +73,13 @@ struct TGpioDriverConfig
     std::string DeviceName;
     WBMQTT::TPublishParameters PublishParameters;
     std::vector<TGpioChipConfig> Chips;
+
+    int WorkerPriority = 0;  // SCHED_FIFO priority of GPIO worker threads, 0 - default scheduling
+    int WorkerCpu = -1;      // CPU to pin GPIO worker thread to, -1 - any CPU
+    int WorkerThreads = 1;   // number of threads to shard chips of main lane across
+    bool LockMemory = false; // lock process memory to avoid page faults in GPIO worker
+
+    std::string TraceFile; // file to record line events to, empty - don't record
 };
 
 struct TConfigValidationHints
@@ -0,0 +1,223 @@
+#include "debounce_filter.h"
+#include "config.h"
+#include "gpio_line.h"
+
+#include <wblib/utils.h>
+
+using namespace std;
+
+namespace
+{
+    /* Time of the latest sample of the grid at or before time */
+    TTimePoint GetSampleTime(const TTimePoint& time, const chrono::nanoseconds& sampleInterval)
+    {
+        auto sinceEpoch = chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch());
+        return TTimePoint(sinceEpoch - sinceEpoch % sampleInterval);
+    }
+
+    uint64_t GetSamplesMask(uint32_t samples)
+    {
+        return (samples >= 64) ? ~0ULL : ((1ULL << samples) - 1);
+    }
+
+    /* Samples within debounce time, at least one */
+    uint32_t GetSampleCount(const chrono::microseconds& timeout, const chrono::nanoseconds& sampleInterval)
+    {
+        auto samples = (chrono::nanoseconds(timeout) + sampleInterval / 2) / sampleInterval;
+        return min<int64_t>(max<int64_t>(samples, 1), 64);
+    }
+
+    uint32_t DivideRoundUp(uint32_t a, uint32_t b)
+    {
+        return (a + b - 1) / b;
+    }
+}
+
+void TDebounceFilter::HandleEdge(const TGpioLine& line, uint8_t level, const TTimePoint& time)
+{}
+
+TTimePoint TDebounceFilter::GetChangeTime(const TGpioLine& line, const TTimePoint& now) const
+{
+    return now;
+}
+
+void TDebounceFilter::HandleCommit(const TGpioLine& line)
+{}
+
+TTimePoint TWindowDebounceFilter::GetSettleTime(const TGpioLine& line) const
+{
+    return line.GetInterruptionTimepoint() + line.GetDebounceTimeout();
+}
+
+TIntegratorDebounceFilter::TIntegratorDebounceFilter(const chrono::nanoseconds& sampleInterval,
+                                                     uint32_t risingSamples,
+                                                     uint32_t fallingSamples)
+    : SampleInterval(sampleInterval),
+      RisingStep(fallingSamples),
+      FallingStep(risingSamples),
+      Threshold(risingSamples * fallingSamples),
+      Count(0),
+      LastSample(TTimePoint::min())
+{}
+
+void TIntegratorDebounceFilter::HandleEdge(const TGpioLine& line, uint8_t level, const TTimePoint& time)
+{
+    auto sampleTime = GetSampleTime(time, SampleInterval);
+    if (LastSample == TTimePoint::min()) {
+        Count = line.GetValue() ? Threshold : 0;
+    } else {
+        // samples since the previous edge saw its level
+        auto samples = static_cast<uint64_t>((sampleTime - LastSample) / SampleInterval);
+        if (line.GetValueUnfiltered()) {
+            Count = min<uint64_t>(Threshold, Count + samples * RisingStep);
+        } else {
+            auto decrement = samples * FallingStep;
+            Count = (decrement >= Count) ? 0 : Count - decrement;
+        }
+    }
+    LastSample = sampleTime;
+}
+
+TTimePoint TIntegratorDebounceFilter::GetSettleTime(const TGpioLine& line) const
+{
+    if (LastSample == TTimePoint::min()) {
+        return line.GetInterruptionTimepoint();
+    }
+    auto samplesLeft = line.GetValueUnfiltered() ? DivideRoundUp(Threshold - Count, RisingStep)
+                                                 : DivideRoundUp(Count, FallingStep);
+    return samplesLeft ? LastSample + SampleInterval * samplesLeft : line.GetInterruptionTimepoint();
+}
+
+TMajorityDebounceFilter::TMajorityDebounceFilter(const chrono::nanoseconds& sampleInterval,
+                                                 const TVoteWindow& rising,
+                                                 const TVoteWindow& falling)
+    : SampleInterval(sampleInterval),
+      Rising(rising),
+      Falling(falling),
+      Samples(max(rising.Samples, falling.Samples)),
+      History(0),
+      LastSample(TTimePoint::min())
+{}
+
+void TMajorityDebounceFilter::HandleEdge(const TGpioLine& line, uint8_t level, const TTimePoint& time)
+{
+    auto mask = GetSamplesMask(Samples);
+    auto sampleTime = GetSampleTime(time, SampleInterval);
+    if (LastSample == TTimePoint::min()) {
+        History = line.GetValue() ? mask : 0;
+    } else {
+        auto samples = static_cast<uint64_t>((sampleTime - LastSample) / SampleInterval);
+        if (samples >= Samples) {
+            History = line.GetValueUnfiltered() ? mask : 0;
+        } else if (samples > 0) {
+            History = ((History << samples) | (line.GetValueUnfiltered() ? GetSamplesMask(samples) : 0)) & mask;
+        }
+    }
+    LastSample = sampleTime;
+}
+
+TTimePoint TMajorityDebounceFilter::GetSettleTime(const TGpioLine& line) const
+{
+    if (LastSample == TTimePoint::min()) {
+        return line.GetInterruptionTimepoint();
+    }
+    auto level = line.GetValueUnfiltered();
+    const auto& window = level ? Rising : Falling;
+    auto history = History;
+    if (CountVotes(history, level) >= window.Votes) {
+        return line.GetInterruptionTimepoint();
+    }
+    // at most window samples of the same level outvote any history
+    auto mask = GetSamplesMask(Samples);
+    uint32_t i = 1;
+    for (; i < window.Samples; ++i) {
+        history = ((history << 1) | level) & mask;
+        if (CountVotes(history, level) >= window.Votes) {
+            break;
+        }
+    }
+    return LastSample + SampleInterval * i;
+}
+
+uint32_t TMajorityDebounceFilter::CountVotes(uint64_t history, uint8_t level) const
+{
+    const auto& window = level ? Rising : Falling;
+    uint32_t ones = __builtin_popcountll(history & GetSamplesMask(window.Samples));
+    return level ? ones : window.Samples - ones;
+}
+
+TPulseDebounceFilter::TPulseDebounceFilter()
+    : ChangeStart(TTimePoint::max()),
+      ChangeDuration(chrono::nanoseconds::zero())
+{}
+
+void TPulseDebounceFilter::HandleEdge(const TGpioLine& line, uint8_t level, const TTimePoint& time)
+{
+    if (level == line.GetValueUnfiltered()) {
+        return;
+    }
+    if (ChangeStart == TTimePoint::max()) {
+        if (level != line.GetValue()) {
+            ChangeStart = time;
+            ChangeDuration = chrono::nanoseconds::zero();
+        }
+    } else if (level == line.GetValue()) {
+        ChangeDuration += time - line.GetInterruptionTimepoint();
+    }
+}
+
+TTimePoint TPulseDebounceFilter::GetSettleTime(const TGpioLine& line) const
+{
+    auto lastEdge = line.GetInterruptionTimepoint();
+    if (ChangeStart == TTimePoint::max() && line.GetValueUnfiltered() == line.GetValue()) {
+        return lastEdge;
+    }
+    if (ChangeStart == TTimePoint::max() || line.GetValueUnfiltered() == line.GetValue()) {
+        // no change in progress or the line is back at committed level: the same as window filter
+        return lastEdge + line.GetDebounceTimeout();
+    }
+    return lastEdge + (line.GetDebounceTimeout() - ChangeDuration);
+}
+
+TTimePoint TPulseDebounceFilter::GetChangeTime(const TGpioLine& line, const TTimePoint& now) const
+{
+    return (ChangeStart != TTimePoint::max() && line.GetValueUnfiltered() != line.GetValue()) ? ChangeStart : now;
+}
+
+void TPulseDebounceFilter::HandleCommit(const TGpioLine& line)
+{
+    ChangeStart = TTimePoint::max();
+}
+
+PUDebounceFilter MakeDebounceFilter(const TGpioLineConfig& config)
+{
+    // sampling filters take DebounceSamples samples per the longer debounce time of the levels and proportionally
+    // fewer per the shorter one, so both levels are sampled on one grid. Zero debounce commits every edge
+    auto risingTimeout = GetDebounceTimeout(config, true);
+    auto fallingTimeout = GetDebounceTimeout(config, false);
+    auto samples = max<uint32_t>(config.DebounceSamples, 1);
+    chrono::nanoseconds sampleInterval = max(risingTimeout, fallingTimeout) / samples;
+    if (sampleInterval.count() > 0) {
+        auto risingSamples = GetSampleCount(risingTimeout, sampleInterval);
+        auto fallingSamples = GetSampleCount(fallingTimeout, sampleInterval);
+        switch (config.DebounceAlgorithm) {
+            case EDebounceAlgorithm::INTEGRATOR:
+                return WBMQTT::MakeUnique<TIntegratorDebounceFilter>(sampleInterval, risingSamples, fallingSamples);
+            case EDebounceAlgorithm::MAJORITY: {
+                // votes are scaled with the window, at least one
+                auto getVotes = [&](uint32_t windowSamples) {
+                    return max<uint32_t>(DivideRoundUp(config.DebounceVotes * windowSamples, samples), 1);
+                };
+                TVoteWindow rising{risingSamples, getVotes(risingSamples)};
+                TVoteWindow falling{fallingSamples, getVotes(fallingSamples)};
+                return WBMQTT::MakeUnique<TMajorityDebounceFilter>(sampleInterval, rising, falling);
+            }
+            default:
+                break;
+        }
+    }
+    if (config.DebounceAlgorithm == EDebounceAlgorithm::PULSE) {
+        return WBMQTT::MakeUnique<TPulseDebounceFilter>();
+    }
+    return WBMQTT::MakeUnique<TWindowDebounceFilter>();
+}
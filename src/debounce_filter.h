@@ -0,0 +1,107 @@
+#pragma once
+
+#include "declarations.h"
+
+#include <chrono>
+
+/**
+ * @brief Debounce algorithm of an input line. Decides when unfiltered level of the line
+ *        is settled and may be committed. The line keeps the level and time of its last edge,
+ *        filters keep only state of their own algorithm.
+ *        Sampling filters sample the level on a virtual grid of sampleInterval derived from edge times,
+ *        so they need no timer per sample.
+ */
+class TDebounceFilter
+{
+public:
+    virtual ~TDebounceFilter() = default;
+
+    /* Unfiltered level of line changes to level at time. Called before the line stores the edge */
+    virtual void HandleEdge(const TGpioLine& line, uint8_t level, const TTimePoint& time);
+
+    /* Time unfiltered level of line is settled at if no more edges come */
+    virtual TTimePoint GetSettleTime(const TGpioLine& line) const = 0;
+
+    /* Time a settled change is counted at, now by default */
+    virtual TTimePoint GetChangeTime(const TGpioLine& line, const TTimePoint& now) const;
+
+    /* Settled level is committed */
+    virtual void HandleCommit(const TGpioLine& line);
+};
+
+/* Level is settled when the line had no edges for debounce time of the level */
+class TWindowDebounceFilter: public TDebounceFilter
+{
+public:
+    TTimePoint GetSettleTime(const TGpioLine& line) const override;
+};
+
+/* Saturating counter of samples: high sample adds, low one subtracts, level is settled when the counter reaches
+   0 or threshold. Steps are weighted, so rising from 0 takes risingSamples high samples and falling from threshold
+   takes fallingSamples low ones. Short noise spikes only delay settling instead of restarting it */
+class TIntegratorDebounceFilter: public TDebounceFilter
+{
+    std::chrono::nanoseconds SampleInterval;
+    uint32_t RisingStep;
+    uint32_t FallingStep;
+    uint32_t Threshold;
+    uint32_t Count;
+    TTimePoint LastSample; // TTimePoint::min() - not sampled yet
+
+public:
+    TIntegratorDebounceFilter(const std::chrono::nanoseconds& sampleInterval,
+                              uint32_t risingSamples,
+                              uint32_t fallingSamples);
+
+    void HandleEdge(const TGpioLine& line, uint8_t level, const TTimePoint& time) override;
+    TTimePoint GetSettleTime(const TGpioLine& line) const override;
+};
+
+/* Last samples of majority filter that vote for a level */
+struct TVoteWindow
+{
+    uint32_t Samples;
+    uint32_t Votes;
+};
+
+/* Level is settled when at least votes of the last samples of its window agree on it */
+class TMajorityDebounceFilter: public TDebounceFilter
+{
+    std::chrono::nanoseconds SampleInterval;
+    TVoteWindow Rising;
+    TVoteWindow Falling;
+    uint32_t Samples; // kept in history, the larger window
+    uint64_t History; // bit 0 - the latest sample
+    TTimePoint LastSample; // TTimePoint::min() - not sampled yet
+
+public:
+    TMajorityDebounceFilter(const std::chrono::nanoseconds& sampleInterval,
+                            const TVoteWindow& rising,
+                            const TVoteWindow& falling);
+
+    void HandleEdge(const TGpioLine& line, uint8_t level, const TTimePoint& time) override;
+    TTimePoint GetSettleTime(const TGpioLine& line) const override;
+
+private:
+    uint32_t CountVotes(uint64_t history, uint8_t level) const;
+};
+
+/* Glitch filter: a change is accepted when the line spent debounce time of the new level in it
+   since the first edge of the change, gaps within the pulse don't restart it. The change is counted
+   at its first edge, so counters measure intervals between leading edges, not bounce lengths.
+   The change is dropped if the line returns to the committed level for the same time */
+class TPulseDebounceFilter: public TDebounceFilter
+{
+    TTimePoint ChangeStart; // first edge away from the committed level, TTimePoint::max() - none
+    std::chrono::nanoseconds ChangeDuration; // time spent away from the committed level until the last edge
+
+public:
+    TPulseDebounceFilter();
+
+    void HandleEdge(const TGpioLine& line, uint8_t level, const TTimePoint& time) override;
+    TTimePoint GetSettleTime(const TGpioLine& line) const override;
+    TTimePoint GetChangeTime(const TGpioLine& line, const TTimePoint& now) const override;
+    void HandleCommit(const TGpioLine& line) override;
+};
+
+PUDebounceFilter MakeDebounceFilter(const TGpioLineConfig& config);
@@ -9,19 +9,28 @@ struct TGpioChipConfig;
 struct TGpioLineConfig;
 struct TInterruptionContext;
 
+class TClock;
+class TGpioBackend;
 class TGpioChipDriver;
 class TGpioChip;
 class TGpioLine;
 class TGpioCounter;
+class TDebounceFilter;
+class TInterruptStormGuard;
+class TEdgeTraceWriter;
 
 using TTimePoint = std::chrono::steady_clock::time_point;
 using TTimeIntervalUs = std::chrono::microseconds;
 
+using PClock = std::shared_ptr<TClock>;
+using PGpioBackend = std::shared_ptr<TGpioBackend>;
 using PGpioChipDriver = std::shared_ptr<TGpioChipDriver>;
 using PGpioChip = std::shared_ptr<TGpioChip>;
 using PWGpioChip = std::weak_ptr<TGpioChip>;
 using PGpioLine = std::shared_ptr<TGpioLine>;
 using PUGpioCounter = std::unique_ptr<TGpioCounter>;
+using PUDebounceFilter = std::unique_ptr<TDebounceFilter>;
+using PUInterruptStormGuard = std::unique_ptr<TInterruptStormGuard>;
 using PUGpioLineConfig = std::unique_ptr<TGpioLineConfig>;
 
 /* Suppress compiler warnings for specified unused variable */
@@ -0,0 +1,265 @@
+#include "edge_trace.h"
+#include "config.h"
+#include "exceptions.h"
+#include "gpio_chip.h"
+#include "gpio_counter.h"
+#include "gpio_line.h"
+#include "log.h"
+
+#include <wblib/utils.h>
+
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <string.h>
+#include <unistd.h>
+
+#define LOG(logger) ::logger.Log() << "[edge trace] "
+
+using namespace std;
+
+namespace
+{
+    const char TRACE_MAGIC[8] = {'W', 'B', 'G', 'P', 'I', 'O', 'T', 'R'};
+    const uint32_t TRACE_VERSION = 1;
+    const size_t BUFFER_SIZE = 64 * 1024;
+    const uint16_t NO_ID = 0xFFFF;
+}
+
+TEdgeTraceWriter::TEdgeTraceWriter(const string& path)
+{
+    Fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (Fd < 0) {
+        wb_throw(TGpioDriverException, "unable to open trace file '" + path + "': " + string(strerror(errno)));
+    }
+    Buffer.reserve(BUFFER_SIZE);
+    Buffer.insert(Buffer.end(), begin(TRACE_MAGIC), end(TRACE_MAGIC));
+    Put(TRACE_VERSION);
+    LOG(Info) << "Recording line events to " << path;
+}
+
+TEdgeTraceWriter::~TEdgeTraceWriter()
+{
+    FlushBuffer();
+    close(Fd);
+}
+
+void TEdgeTraceWriter::WriteEdge(const TGpioLine& line, uint8_t level, const TTimePoint& time)
+{
+    WriteLineEvent(EEdgeTraceRecordType::EDGE, line, level, time);
+}
+
+void TEdgeTraceWriter::WriteLevel(const TGpioLine& line, uint8_t level, const TTimePoint& time)
+{
+    WriteLineEvent(EEdgeTraceRecordType::LEVEL, line, level, time);
+}
+
+void TEdgeTraceWriter::WritePollSample(const vector<PGpioLine>& lines, uint64_t values, const TTimePoint& time)
+{
+    lock_guard<mutex> lock(Mutex);
+
+    vector<uint16_t> lineIds;
+    lineIds.reserve(lines.size());
+    for (const auto& line: lines) {
+        lineIds.push_back(GetLineId(*line));
+        if (lineIds.back() == NO_ID) {
+            return;
+        }
+    }
+
+    auto itGroup = Groups.find(lineIds);
+    if (itGroup == Groups.end()) {
+        if (Groups.size() == NO_ID) {
+            return;
+        }
+        uint16_t id = Groups.size();
+        Put(EEdgeTraceRecordType::GROUP);
+        Put(id);
+        Put<uint8_t>(lineIds.size());
+        for (auto lineId: lineIds) {
+            Put(lineId);
+        }
+        itGroup = Groups.emplace(move(lineIds), TGroup{id, ~values}).first;
+    }
+
+    auto& group = itGroup->second;
+    if (group.Values == values) {
+        return;
+    }
+    group.Values = values;
+
+    Put(EEdgeTraceRecordType::POLL);
+    Put(group.Id);
+    PutTime(time);
+    Put(values);
+    if (Buffer.size() >= BUFFER_SIZE) {
+        FlushBuffer();
+    }
+}
+
+void TEdgeTraceWriter::Flush()
+{
+    lock_guard<mutex> lock(Mutex);
+    FlushBuffer();
+}
+
+void TEdgeTraceWriter::WriteLineEvent(EEdgeTraceRecordType type,
+                                      const TGpioLine& line,
+                                      uint8_t level,
+                                      const TTimePoint& time)
+{
+    lock_guard<mutex> lock(Mutex);
+
+    auto id = GetLineId(line);
+    if (id == NO_ID) {
+        return;
+    }
+    Put(type);
+    Put(id);
+    Put(level);
+    PutTime(time);
+    if (Buffer.size() >= BUFFER_SIZE) {
+        FlushBuffer();
+    }
+}
+
+uint16_t TEdgeTraceWriter::GetLineId(const TGpioLine& line)
+{
+    auto itLine = LineIds.find(&line);
+    if (itLine != LineIds.end()) {
+        return itLine->second;
+    }
+    if (LineIds.size() == NO_ID) {
+        return NO_ID;
+    }
+
+    // state of line before its first event, so replay starts from the same point
+    const auto& config = line.GetConfig();
+    const auto& counter = line.GetCounter();
+    auto name = config->Name.substr(0, UINT8_MAX);
+
+    uint16_t id = LineIds.size();
+    Put(EEdgeTraceRecordType::LINE);
+    Put(id);
+    uint8_t flags = line.IsDebouncedByKernel() ? TEdgeTraceRecord::FLAG_DEBOUNCED_BY_KERNEL : 0;
+    if (line.GetInterruptSupport() == EInterruptSupport::NO) {
+        flags |= TEdgeTraceRecord::FLAG_POLLED;
+    }
+    if (line.HasChip() && !line.AccessChip()->IsUapiV2Supported()) {
+        flags |= TEdgeTraceRecord::FLAG_UAPI_V1;
+    }
+    Put(flags);
+    Put(counter ? counter->GetInterruptEdge() : config->InterruptEdge);
+    Put(line.GetValue());
+    Put(counter ? counter->GetTotal() : 0.0f);
+    Put<uint8_t>(name.size());
+    Buffer.insert(Buffer.end(), name.begin(), name.end());
+
+    LineIds[&line] = id;
+    return id;
+}
+
+template<typename T> void TEdgeTraceWriter::Put(const T& value)
+{
+    auto bytes = reinterpret_cast<const uint8_t*>(&value);
+    Buffer.insert(Buffer.end(), bytes, bytes + sizeof(T));
+}
+
+void TEdgeTraceWriter::PutTime(const TTimePoint& time)
+{
+    Put<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch()).count());
+}
+
+void TEdgeTraceWriter::FlushBuffer()
+{
+    size_t written = 0;
+    while (written < Buffer.size()) {
+        auto size = write(Fd, Buffer.data() + written, Buffer.size() - written);
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG(Error) << "Write to trace file failed: " << strerror(errno) << ". " << Buffer.size() - written
+                       << " bytes are lost";
+            break;
+        }
+        written += size;
+    }
+    Buffer.clear();
+}
+
+TEdgeTraceReader::TEdgeTraceReader(const string& path): Position(0)
+{
+    ifstream file(path, ios::binary);
+    if (!file.is_open()) {
+        wb_throw(TGpioDriverException, "unable to open trace file '" + path + "'");
+    }
+    Data.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+
+    if (Data.size() < sizeof(TRACE_MAGIC) || memcmp(Data.data(), TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0) {
+        wb_throw(TGpioDriverException, "'" + path + "' is not a trace file");
+    }
+    Position = sizeof(TRACE_MAGIC);
+    auto version = Get<uint32_t>();
+    if (version != TRACE_VERSION) {
+        wb_throw(TGpioDriverException, "unsupported version " + to_string(version) + " of trace file '" + path + "'");
+    }
+}
+
+bool TEdgeTraceReader::Next(TEdgeTraceRecord& record)
+{
+    if (Position == Data.size()) {
+        return false;
+    }
+
+    record.Type = Get<EEdgeTraceRecordType>();
+    record.Id = Get<uint16_t>();
+    switch (record.Type) {
+        case EEdgeTraceRecordType::LINE: {
+            record.Flags = Get<uint8_t>();
+            record.CounterEdge = Get<EGpioEdge>();
+            record.Values = Get<uint8_t>();
+            record.CounterTotal = Get<float>();
+            auto nameSize = Get<uint8_t>();
+            if (Data.size() - Position < nameSize) {
+                wb_throw(TGpioDriverException, "trace file is truncated");
+            }
+            record.Name.assign(Data.begin() + Position, Data.begin() + Position + nameSize);
+            Position += nameSize;
+            break;
+        }
+        case EEdgeTraceRecordType::GROUP: {
+            record.LineIds.resize(Get<uint8_t>());
+            for (auto& lineId: record.LineIds) {
+                lineId = Get<uint16_t>();
+            }
+            break;
+        }
+        case EEdgeTraceRecordType::EDGE:
+        case EEdgeTraceRecordType::LEVEL: {
+            record.Values = Get<uint8_t>();
+            record.Time = TTimePoint(chrono::nanoseconds(Get<uint64_t>()));
+            break;
+        }
+        case EEdgeTraceRecordType::POLL: {
+            record.Time = TTimePoint(chrono::nanoseconds(Get<uint64_t>()));
+            record.Values = Get<uint64_t>();
+            break;
+        }
+        default:
+            wb_throw(TGpioDriverException,
+                     "unknown record type " + to_string(static_cast<int>(record.Type)) + " in trace file");
+    }
+    return true;
+}
+
+template<typename T> T TEdgeTraceReader::Get()
+{
+    if (Data.size() - Position < sizeof(T)) {
+        wb_throw(TGpioDriverException, "trace file is truncated");
+    }
+    T value;
+    memcpy(&value, Data.data() + Position, sizeof(T));
+    Position += sizeof(T);
+    return value;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "declarations.h"
+#include "types.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Binary trace of raw line events, in host byte order:
+ *   header: "WBGPIOTR", uint32 version
+ *   records: uint8 type, then
+ *     LINE:  uint16 line id, uint8 flags, uint8 counter edge, uint8 value, float counter total,
+ *            uint8 name length, name - state of line before its first event
+ *     GROUP: uint16 group id, uint8 line count, uint16 line ids - lines read by one request
+ *     EDGE:  uint16 line id, uint8 level, uint64 time - edge reported by kernel
+ *     LEVEL: uint16 line id, uint8 level, uint64 time - level read back after edges (uAPI v1)
+ *     POLL:  uint16 group id, uint64 time, uint64 levels - changed sample of group lines, bit per line
+ * Time is steady clock in nanoseconds, as used by driver.
+ * Flags of LINE tell how the line was read, so replay sets up its simulated chip the same way
+ */
+enum class EEdgeTraceRecordType : uint8_t
+{
+    LINE = 1,
+    GROUP = 2,
+    EDGE = 3,
+    LEVEL = 4,
+    POLL = 5
+};
+
+struct TEdgeTraceRecord
+{
+    static constexpr uint8_t FLAG_DEBOUNCED_BY_KERNEL = 1;
+    static constexpr uint8_t FLAG_POLLED = 2;  // input without interrupts
+    static constexpr uint8_t FLAG_UAPI_V1 = 4; // chip without uAPI v2
+
+    EEdgeTraceRecordType Type;
+    uint16_t Id = 0;               // line id, group id for GROUP and POLL
+    uint8_t Flags = 0;             // LINE
+    EGpioEdge CounterEdge;         // LINE
+    float CounterTotal = 0;        // LINE
+    std::string Name;              // LINE
+    std::vector<uint16_t> LineIds; // GROUP
+    TTimePoint Time;               // EDGE, LEVEL, POLL
+    uint64_t Values = 0;           // level of line, bit per line for POLL
+};
+
+/* Writes trace of line events. Shared by lane workers, buffers records and writes them by large chunks */
+class TEdgeTraceWriter
+{
+    struct TGroup
+    {
+        uint16_t Id;
+        uint64_t Values;
+    };
+
+    std::mutex Mutex;
+    int Fd;
+    std::vector<uint8_t> Buffer;
+    std::unordered_map<const TGpioLine*, uint16_t> LineIds;
+    std::map<std::vector<uint16_t>, TGroup> Groups;
+
+public:
+    explicit TEdgeTraceWriter(const std::string& path);
+    ~TEdgeTraceWriter();
+
+    TEdgeTraceWriter(const TEdgeTraceWriter&) = delete;
+    TEdgeTraceWriter& operator=(const TEdgeTraceWriter&) = delete;
+
+    void WriteEdge(const TGpioLine& line, uint8_t level, const TTimePoint& time);
+    void WriteLevel(const TGpioLine& line, uint8_t level, const TTimePoint& time);
+
+    /* Lines must be read by one request, values have bit per line in order of lines.
+       Sample equal to the previous one of the same lines is not written */
+    void WritePollSample(const std::vector<PGpioLine>& lines, uint64_t values, const TTimePoint& time);
+
+    void Flush();
+
+private:
+    void WriteLineEvent(EEdgeTraceRecordType type, const TGpioLine& line, uint8_t level, const TTimePoint& time);
+    uint16_t GetLineId(const TGpioLine& line);
+    template<typename T> void Put(const T& value);
+    void PutTime(const TTimePoint& time);
+    void FlushBuffer();
+};
+
+/* Reads trace written by TEdgeTraceWriter. Throws TGpioDriverException if trace is malformed */
+class TEdgeTraceReader
+{
+    std::vector<uint8_t> Data;
+    size_t Position;
+
+public:
+    explicit TEdgeTraceReader(const std::string& path);
+
+    /* Returns false at the end of trace */
+    bool Next(TEdgeTraceRecord& record);
+
+private:
+    template<typename T> T Get();
+};
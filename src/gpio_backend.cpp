@@ -0,0 +1,78 @@
+#include "gpio_backend.h"
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace
+{
+    class TKernelGpioBackend: public TGpioBackend
+    {
+    public:
+        int OpenChip(const std::string& path) override
+        {
+            return open(path.c_str(), O_RDWR | O_CLOEXEC);
+        }
+
+        int Close(int fd) override
+        {
+            return close(fd);
+        }
+
+        int GetChipInfo(int chipFd, gpiochip_info& info) override
+        {
+            return ioctl(chipFd, GPIO_GET_CHIPINFO_IOCTL, &info);
+        }
+
+        int GetLineInfo(int chipFd, gpioline_info& info) override
+        {
+            return ioctl(chipFd, GPIO_GET_LINEINFO_IOCTL, &info);
+        }
+
+        int GetLineInfo(int chipFd, gpio_v2_line_info& info) override
+        {
+            return ioctl(chipFd, GPIO_V2_GET_LINEINFO_IOCTL, &info);
+        }
+
+        int RequestLineHandle(int chipFd, gpiohandle_request& req) override
+        {
+            return ioctl(chipFd, GPIO_GET_LINEHANDLE_IOCTL, &req);
+        }
+
+        int RequestLineEvent(int chipFd, gpioevent_request& req) override
+        {
+            return ioctl(chipFd, GPIO_GET_LINEEVENT_IOCTL, &req);
+        }
+
+        int RequestLines(int chipFd, gpio_v2_line_request& req) override
+        {
+            return ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &req);
+        }
+
+        int GetLineValues(int fd, gpiohandle_data& data) override
+        {
+            return ioctl(fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data);
+        }
+
+        int SetLineValues(int fd, gpiohandle_data& data) override
+        {
+            return ioctl(fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data);
+        }
+
+        int GetLineValues(int fd, gpio_v2_line_values& values) override
+        {
+            return ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values);
+        }
+
+        int SetLineConfig(int fd, gpio_v2_line_config& config) override
+        {
+            return ioctl(fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &config);
+        }
+    };
+} // namespace
+
+const PGpioBackend& GetKernelGpioBackend()
+{
+    static const PGpioBackend backend = std::make_shared<TKernelGpioBackend>();
+    return backend;
+}
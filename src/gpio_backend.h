@@ -0,0 +1,43 @@
+#pragma once
+
+#include "declarations.h"
+
+#include <linux/gpio.h>
+#include <string>
+
+/**
+ * @brief Access to GPIO chips: chip and line info, line requests and their values.
+ *        Methods mirror GPIO character device ioctls: they return negative value and set errno on failure.
+ *        Fd of event request is read by the driver as is, so it must deliver gpioevent_data
+ *        (uAPI v1) or gpio_v2_line_event (uAPI v2) records like fd of kernel request does.
+ */
+class TGpioBackend
+{
+public:
+    virtual ~TGpioBackend() = default;
+
+    /* Returns fd of chip */
+    virtual int OpenChip(const std::string& path) = 0;
+
+    /* Closes fd of chip or line request */
+    virtual int Close(int fd) = 0;
+
+    virtual int GetChipInfo(int chipFd, gpiochip_info& info) = 0;
+    virtual int GetLineInfo(int chipFd, gpioline_info& info) = 0;
+    virtual int GetLineInfo(int chipFd, gpio_v2_line_info& info) = 0;
+
+    /* Requests fill fd of request */
+    virtual int RequestLineHandle(int chipFd, gpiohandle_request& req) = 0;
+    virtual int RequestLineEvent(int chipFd, gpioevent_request& req) = 0;
+    virtual int RequestLines(int chipFd, gpio_v2_line_request& req) = 0;
+
+    virtual int GetLineValues(int fd, gpiohandle_data& data) = 0;
+    virtual int SetLineValues(int fd, gpiohandle_data& data) = 0;
+    virtual int GetLineValues(int fd, gpio_v2_line_values& values) = 0;
+
+    /* Reconfigures lines of uAPI v2 request, e.g. edge detection of some of them */
+    virtual int SetLineConfig(int fd, gpio_v2_line_config& config) = 0;
+};
+
+/* Backend of /dev/gpiochip* character devices, shared by all chips */
+const PGpioBackend& GetKernelGpioBackend();
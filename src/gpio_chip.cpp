@@ -8,17 +8,20 @@
 #include <wblib/utils.h>
 
 #include <cassert>
-#include <fcntl.h>
-#include <sys/ioctl.h>
-#include <unistd.h>
 
 #define LOG(logger) ::logger.Log() << "[gpio chip] "
 
 using namespace std;
 
-TGpioChip::TGpioChip(const string& path): Fd(-1), Path(path), Valid(false)
+TGpioChip::TGpioChip(const string& path, const PGpioBackend& backend)
+    : Backend(backend),
+      Fd(-1),
+      Path(path),
+      Valid(false),
+      UapiV2Supported(false),
+      ReadbackLineCount(0)
 {
-    Fd = open(Path.c_str(), O_RDWR | O_CLOEXEC);
+    Fd = Backend->OpenChip(Path);
     if (Fd < 0) {
         Name = Path;
         Label = "disconnected";
@@ -30,10 +33,10 @@ TGpioChip::TGpioChip(const string& path): Fd(-1), Path(path), Valid(false)
 
     LOG(Debug) << "Open chip at " << Path;
 
-    WB_SCOPE_THROW_EXIT(close(Fd);)
+    WB_SCOPE_THROW_EXIT(Backend->Close(Fd);)
 
     gpiochip_info info{};
-    int retVal = ioctl(Fd, GPIO_GET_CHIPINFO_IOCTL, &info);
+    int retVal = Backend->GetChipInfo(Fd, info);
     if (retVal < 0) {
         wb_throw(TGpioDriverException, "unable to get GPIO chip info from '" + Path + "'");
     }
@@ -47,9 +50,22 @@ TGpioChip::TGpioChip(const string& path): Fd(-1), Path(path), Valid(false)
     if (Label.empty()) {
         Label = "unknown";
     }
+
+    // Kernels without uAPI v2 reject unknown ioctls with EINVAL
+    if (LineCount > 0) {
+        gpio_v2_line_info lineInfo{};
+        UapiV2Supported = (Backend->GetLineInfo(Fd, lineInfo) >= 0);
+    }
+    LOG(Debug) << Describe() << (UapiV2Supported ? " supports" : " does not support") << " GPIO uAPI v2";
 }
 
-TGpioChip::TGpioChip(): Fd(-1), Path("/dev/null"), Valid(false)
+TGpioChip::TGpioChip()
+    : Backend(GetKernelGpioBackend()),
+      Fd(-1),
+      Path("/dev/null"),
+      Valid(false),
+      UapiV2Supported(false),
+      ReadbackLineCount(0)
 {
     LineCount = 0;
     Name = "Dummy gpiochip";
@@ -59,7 +75,7 @@ TGpioChip::TGpioChip(): Fd(-1), Path("/dev/null"), Valid(false)
 TGpioChip::~TGpioChip()
 {
     if (Fd > -1) {
-        close(Fd);
+        Backend->Close(Fd);
         LOG(Debug) << "Close chip at " << Path;
     }
 }
@@ -121,7 +137,32 @@ int TGpioChip::GetFd() const
     return Fd;
 }
 
+const PGpioBackend& TGpioChip::GetBackend() const
+{
+    return Backend;
+}
+
 bool TGpioChip::IsValid() const
 {
     return Valid;
 }
+
+bool TGpioChip::IsUapiV2Supported() const
+{
+    return UapiV2Supported;
+}
+
+size_t TGpioChip::GetReadbackLineCount() const
+{
+    return ReadbackLineCount;
+}
+
+void TGpioChip::UpdateReadbackLineCount(bool isAdded)
+{
+    if (isAdded) {
+        ++ReadbackLineCount;
+    } else {
+        assert(ReadbackLineCount > 0);
+        --ReadbackLineCount;
+    }
+}
@@ -2,19 +2,23 @@
 
 #include "config.h"
 #include "declarations.h"
+#include "gpio_backend.h"
 
 #include <linux/gpio.h>
 
 class TGpioChip: public std::enable_shared_from_this<TGpioChip>
 {
+    PGpioBackend Backend;
     int Fd;
     std::string Name, Label, Path;
     uint32_t LineCount;
     bool Valid;
+    bool UapiV2Supported;
+    size_t ReadbackLineCount;
 
 public:
     TGpioChip(); // dummy gpiochip for tests
-    TGpioChip(const std::string& path);
+    TGpioChip(const std::string& path, const PGpioBackend& backend = GetKernelGpioBackend());
     ~TGpioChip();
 
     std::vector<PGpioLine> LoadLines(const TLinesConfig& linesConfigs);
@@ -26,8 +30,16 @@ public:
     uint32_t GetLineCount() const;
     uint32_t GetNumber() const;
     int GetFd() const;
+    const PGpioBackend& GetBackend() const;
     bool IsValid() const;
 
+    /* true if kernel supports GPIO character device uAPI v2 (linux >= 5.10) */
+    bool IsUapiV2Supported() const;
+
+    /* Number of lines that need periodic readback, kept by lines themselves. See TGpioLine::NeedsReadback() */
+    size_t GetReadbackLineCount() const;
+    void UpdateReadbackLineCount(bool isAdded);
+
 private:
     void ThrowErrIfNotValid() const;
 };
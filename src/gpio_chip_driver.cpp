@@ -1,8 +1,10 @@
 #include "gpio_chip_driver.h"
+#include "edge_trace.h"
 #include "exceptions.h"
 #include "gpio_chip.h"
 #include "gpio_counter.h"
 #include "gpio_line.h"
+#include "interrupt_storm_guard.h"
 #include "interruption_context.h"
 #include "log.h"
 #include "utils.h"
@@ -11,10 +13,10 @@
 
 #include <algorithm>
 #include <cassert>
+#include <fcntl.h>
 #include <fstream>
 #include <string.h>
 #include <sys/epoll.h>
-#include <sys/ioctl.h>
 #include <sys/timerfd.h>
 #include <unistd.h>
 
@@ -23,6 +25,7 @@
 using namespace std;
 
 const auto CONSUMER = "wb-mqtt-gpio";
+const size_t EVENTS_BATCH_SIZE = 64;
 
 namespace
 {
@@ -45,22 +48,118 @@ namespace
 
         return flags;
     }
-} // namespace
 
-TGpioChipDriver::TGpioChipDriver(const TGpioChipConfig& config): AddedToEpoll(false)
-{
-    Chip = make_shared<TGpioChip>(config.Path);
+    void SetNonBlocking(int fd)
+    {
+        auto flags = fcntl(fd, F_GETFL);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+            wb_throw(TGpioDriverException, "unable to make line event fd non-blocking: " + string(strerror(errno)));
+        }
+    }
 
-    unordered_map<uint32_t, vector<vector<PGpioLine>>> pollLines;
-    auto addToPoll = [&pollLines](const PGpioLine& line) {
-        auto& lineBulks = pollLines[GetFlagsFromConfig(*line->GetConfig())];
+    /* Reads up to maxCount events at once. Returns 0 if fd has no pending events */
+    template<typename TEvent> size_t ReadEvents(int fd, TEvent* events, size_t maxCount)
+    {
+        auto size = read(fd, events, sizeof(TEvent) * maxCount);
+        if (size < 0) {
+            if (errno == EAGAIN) {
+                return 0;
+            }
+            LOG(Error) << "Read line events failed: " << strerror(errno);
+            wb_throw(TGpioDriverException, "unable to read line event data: " + string(strerror(errno)));
+        }
+        return size / sizeof(TEvent);
+    }
+
+    uint64_t GetV2EventFlagsFromConfig(const TGpioLineConfig& config)
+    {
+        uint64_t flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
 
-        if (lineBulks.empty() || lineBulks.back().size() == GPIOHANDLES_MAX) {
+        if (config.IsOpenDrain)
+            flags |= GPIO_V2_LINE_FLAG_OPEN_DRAIN;
+        if (config.IsOpenSource)
+            flags |= GPIO_V2_LINE_FLAG_OPEN_SOURCE;
+        if (config.IsActiveLow)
+            flags |= GPIO_V2_LINE_FLAG_ACTIVE_LOW;
+
+        return flags;
+    }
+
+    /* Config of uAPI v2 request of lines: edge detection is off for lines in interrupt storm,
+       lines for which isKernelDebounced() returns true get one debounce attribute per distinct period */
+    template<typename TPredicate>
+    gpio_v2_line_config MakeV2LineConfig(const vector<PGpioLine>& lines, TPredicate isKernelDebounced)
+    {
+        gpio_v2_line_config config{};
+        config.flags = GetV2EventFlagsFromConfig(*lines.front()->GetConfig());
+
+        uint64_t stormLines = 0;
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (lines[i]->IsInterruptStorm()) {
+                stormLines |= 1ULL << i;
+            }
+        }
+        if (stormLines) {
+            auto& attr = config.attrs[config.num_attrs++];
+            attr.attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+            attr.attr.flags = config.flags & ~(GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING);
+            attr.mask = stormLines;
+        }
+
+        uint32_t firstDebounce = config.num_attrs;
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (!isKernelDebounced(lines[i])) {
+                continue;
+            }
+            uint32_t period = lines[i]->GetConfig()->DebounceTimeout.count();
+            uint32_t j = firstDebounce;
+            while (j < config.num_attrs && config.attrs[j].attr.debounce_period_us != period) {
+                ++j;
+            }
+            if (j < GPIO_V2_LINE_NUM_ATTRS_MAX) {
+                auto& attr = config.attrs[j];
+                attr.attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+                attr.attr.debounce_period_us = period;
+                attr.mask |= (1ULL << i);
+                config.num_attrs = max(config.num_attrs, j + 1);
+            }
+        }
+        return config;
+    }
+
+    using TGpioLineBulks = unordered_map<uint32_t, vector<vector<PGpioLine>>>;
+
+    /* Group lines with the same request flags into bulks of at most maxSize lines */
+    void AddToBulk(TGpioLineBulks& bulks, const PGpioLine& line, size_t maxSize)
+    {
+        auto& lineBulks = bulks[GetFlagsFromConfig(*line->GetConfig())];
+
+        if (lineBulks.empty() || lineBulks.back().size() == maxSize) {
             lineBulks.emplace_back();
         }
 
         lineBulks.back().push_back(line);
-    };
+    }
+} // namespace
+
+TGpioChipDriver::TGpioChipDriver(const TGpioChipConfig& config, const PGpioBackend& backend, const PClock& clock)
+    : DebounceQueue(clock, &TGpioLine::AccessDebounceQueuePosition),
+      CounterQueue(clock),
+      StormQueue(clock),
+      PollTimerFd(-1),
+      PollConfig(config.Poll),
+      ReadLatency(chrono::nanoseconds::zero()),
+      Backend(backend),
+      Clock(clock),
+      TraceWriter(nullptr),
+      Epfd(-1),
+      AddedToEpoll(false),
+      ReadLevelAfterEvents(false)
+{
+    Chip = make_shared<TGpioChip>(config.Path, Backend);
+
+    TGpioLineBulks pollLines, interruptLines;
+    auto addToPoll = [&pollLines](const PGpioLine& line) { AddToBulk(pollLines, line, GPIOHANDLES_MAX); };
 
     if (!Chip->IsValid()) {
         for (const auto& lineConfig: config.Lines) {
@@ -71,13 +170,18 @@ TGpioChipDriver::TGpioChipDriver(const TGpioChipConfig& config): AddedToEpoll(fa
         return;
     }
 
+    // Kernels predating uAPI v2 are known to report wrong edge polarity in some cases
+    ReadLevelAfterEvents = !Chip->IsUapiV2Supported();
+
     for (const auto& line: Chip->LoadLines(config.Lines)) {
         if (!ReleaseLineIfUsed(line)) {
             LOG(Error) << "Skipping " << line->DescribeShort();
         }
         switch (line->GetConfig()->Direction) {
             case EGpioDirection::Input: {
-                if (!InitInputInterrupts(line)) {
+                if (Chip->IsUapiV2Supported()) {
+                    AddToBulk(interruptLines, line, GPIO_V2_LINES_MAX);
+                } else if (!InitInputInterrupts(line)) {
                     addToPoll(line);
                 }
                 break;
@@ -93,6 +197,21 @@ TGpioChipDriver::TGpioChipDriver(const TGpioChipConfig& config): AddedToEpoll(fa
         }
     }
 
+    /* Listen to all inputs with the same flags by a single uAPI v2 request.
+       If some of them don't support interrupts, fall back to per-line requests */
+    for (const auto& flagsLines: interruptLines) {
+        for (const auto& lines: flagsLines.second) {
+            if (TryListenLines(lines)) {
+                continue;
+            }
+            for (const auto& line: lines) {
+                if (!InitInputInterrupts(line)) {
+                    addToPoll(line);
+                }
+            }
+        }
+    }
+
     /* Initialize polling if line doesn't support interrupts */
     for (const auto& flagsLines: pollLines) {
         const auto flags = flagsLines.first;
@@ -115,13 +234,27 @@ TGpioChipDriver::TGpioChipDriver(const TGpioChipConfig& config): AddedToEpoll(fa
 
     AutoDetectInterruptEdges();
     ReadInputValues();
+    MeasureReadLatency();
 }
 
-TGpioChipDriver::TGpioChipDriver(): AddedToEpoll(false)
+TGpioChipDriver::TGpioChipDriver()
+    : DebounceQueue(GetSteadyClock(), &TGpioLine::AccessDebounceQueuePosition),
+      PollTimerFd(-1),
+      ReadLatency(chrono::nanoseconds::zero()),
+      Backend(GetKernelGpioBackend()),
+      Clock(GetSteadyClock()),
+      TraceWriter(nullptr),
+      Epfd(-1),
+      AddedToEpoll(false),
+      ReadLevelAfterEvents(false)
 {}
 
 TGpioChipDriver::~TGpioChipDriver()
 {
+    if (PollTimerFd >= 0) {
+        close(PollTimerFd);
+    }
+
     for (const auto& fdLines: Lines) {
         auto fd = fdLines.first;
         const auto& lines = fdLines.second;
@@ -133,35 +266,7 @@ TGpioChipDriver::~TGpioChipDriver()
             }
         }
 
-        close(fd);
-    }
-}
-
-int TGpioChipDriver::CreateIntervalTimer()
-{
-    int tfd = timerfd_create(CLOCK_MONOTONIC, 0);
-    if (tfd == -1) {
-        LOG(Error) << "timerfd_create failed: " << strerror(errno);
-        wb_throw(TGpioDriverException, "unable to create timer: timerfd_create failed with " + string(strerror(errno)));
-    }
-    return tfd;
-}
-
-void TGpioChipDriver::SetIntervalTimer(int tfd, std::chrono::microseconds intervalUs)
-{
-    auto sec = std::chrono::floor<std::chrono::seconds>(intervalUs);
-    auto nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(intervalUs - sec);
-
-    struct itimerspec ts;
-    ts.it_value.tv_sec = sec.count();
-    ts.it_value.tv_nsec = nsec.count();
-    ts.it_interval.tv_sec = 0;
-    ts.it_interval.tv_nsec = 0;
-
-    if (timerfd_settime(tfd, 0, &ts, NULL) < 0) {
-        LOG(Error) << "timerfd_settime failed: " << strerror(errno);
-        close(tfd);
-        wb_throw(TGpioDriverException, "unable to setup timer: timerfd_settime failed with " + string(strerror(errno)));
+        Backend->Close(fd);
     }
 }
 
@@ -185,83 +290,369 @@ const TGpioChipDriver::TGpioLinesByOffsetMap& TGpioChipDriver::MapInitiallyDisco
 void TGpioChipDriver::AddToEpoll(int epfd)
 {
     AddedToEpoll = true;
+    Epfd = epfd;
 
-    FOR_EACH_LINE(this, line)
-    {
+    // sources of previous epoll (if any) are dropped: it is closed together with its worker
+    EpollSources.clear();
+    EpollSources.reserve(Lines.size() + 4);
+
+    // each line has at most one pending deadline, so the worker never allocates to schedule debounce
+    size_t lineCount = 0;
+    for (const auto& fdLines: Lines) {
+        lineCount += fdLines.second.size();
+    }
+    DebounceQueue.Reserve(lineCount);
+    CounterQueue.Reserve(lineCount);
+    StormQueue.Reserve(lineCount);
+
+    EpollSources.push_back(
+        {DebounceQueue.GetFd(), [this](const TInterruptionContext&) { return HandleTimerInterrupt(); }});
+    EpollSources.push_back(
+        {CounterQueue.GetFd(), [this](const TInterruptionContext&) { return HandleCounterTimerInterrupt(); }});
+    EpollSources.push_back(
+        {StormQueue.GetFd(), [this](const TInterruptionContext&) { return HandleStormTimerInterrupt(); }});
+
+    if (!PolledInputs.empty()) {
+        if (PollTimerFd < 0) {
+            PollTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            if (PollTimerFd < 0) {
+                wb_throw(TGpioDriverException,
+                         "unable to create poll timer: timerfd_create failed with " + string(strerror(errno)));
+            }
+        }
+        auto firstPoll = Clock->Now() + PollConfig.Interval;
+        for (auto& input: PolledInputs) {
+            input.NextPoll = firstPoll;
+        }
+        ArmPollTimer();
+        EpollSources.push_back(
+            {PollTimerFd, [this](const TInterruptionContext&) { return HandlePollTimerInterrupt(); }});
+    }
+
+    for (auto& source: EpollSources) {
+        struct epoll_event timerEvent{};
+        timerEvent.events = EPOLLIN;
+        timerEvent.data.ptr = &source;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, source.Fd, &timerEvent) < 0) {
+            LOG(Error) << "epoll_ctl error: '" << strerror(errno);
+            wb_throw(TGpioDriverException,
+                     "unable to add timer to epoll: epoll_ctl failed with " + string(strerror(errno)));
+        }
+    }
+
+    for (const auto& fdLines: Lines) {
+        auto fd = fdLines.first;
+        const auto& line = fdLines.second.front();
         if (line->IsOutput() || line->GetInterruptSupport() != EInterruptSupport::YES) {
-            return;
+            continue;
+        }
+
+        auto itRequest = MultiLineEventRequests.find(fd);
+        if (itRequest != MultiLineEventRequests.end()) {
+            const auto& requestLines = itRequest->second;
+            EpollSources.push_back(
+                {fd, [this, fd, &requestLines](const TInterruptionContext&) {
+                     return HandleGpioInterrupts(fd, requestLines);
+                 }});
+        } else {
+            assert(fdLines.second.size() == 1);
+            // the line is requested again on edge storms, so the handler reads fd of its source at every wakeup
+            EpollSources.push_back({fd, nullptr});
+            auto& source = EpollSources.back();
+            source.Handle = [this, &source, line](const TInterruptionContext&) {
+                return HandleGpioInterrupt(source.Fd, line);
+            };
+
+            // a line in edge storm is requested without events, it is listened again when the storm ends
+            if (line->IsInterruptStorm()) {
+                continue;
+            }
         }
 
         struct epoll_event ep_event{};
 
         ep_event.events = EPOLLIN | EPOLLPRI;
-        ep_event.data.fd = line->GetFd();
+        ep_event.data.ptr = &EpollSources.back();
 
-        if (epoll_ctl(epfd, EPOLL_CTL_ADD, line->GetFd(), &ep_event) < 0) {
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ep_event) < 0) {
             LOG(Error) << "epoll_ctl error: '" << strerror(errno) << "' at " << line->DescribeShort();
         }
+    }
+}
 
-        auto timerFd = line->GetTimerFd();
-        ep_event.events = EPOLLIN;
-        ep_event.data.fd = timerFd;
-        if (epoll_ctl(epfd, EPOLL_CTL_ADD, timerFd, &ep_event) < 0) {
-            LOG(Error) << "epoll_ctl error: '" << strerror(errno);
-            wb_throw(TGpioDriverException,
-                     "unable to add timer to epoll: epoll_ctl failed with " + string(strerror(errno)));
+void TGpioChipDriver::SetTraceWriter(TEdgeTraceWriter* writer)
+{
+    TraceWriter = writer;
+}
+
+bool TGpioChipDriver::HandleGpioInterrupt(int fd, const PGpioLine& line)
+{
+    if (line->IsInterruptStorm()) {
+        return false; // the event request is already replaced by a handle request
+    }
+
+    bool isHandled = false;
+    TTimePoint time;
+
+    // uAPI v1 events of kernels older than 5.7 are timestamped by CLOCK_REALTIME
+    auto timestampOffset = TInterruptionContext::InterruptTimestampClockIsMonotonic ? chrono::nanoseconds::zero()
+                                                                                     : Clock->GetRealtimeOffset();
+
+    gpioevent_data events[EVENTS_BATCH_SIZE];
+    size_t count;
+    do {
+        count = ReadEvents(fd, events, EVENTS_BATCH_SIZE);
+        for (size_t i = 0; i < count; ++i) {
+            time = TTimePoint(chrono::nanoseconds(events[i].timestamp) - timestampOffset);
+            HandleLineEdge(line, events[i].id == GPIOEVENT_EVENT_RISING_EDGE, time);
+            isHandled = true;
         }
-    });
+    } while (count == EVENTS_BATCH_SIZE && !line->IsInterruptStorm()); // short read means the queue is drained
+
+    if (isHandled && ReadLevelAfterEvents && !line->IsInterruptStorm()) {
+        gpiohandle_data values;
+        if (Backend->GetLineValues(fd, values) < 0) {
+            LOG(Error) << "GPIOHANDLE_GET_LINE_VALUES_IOCTL failed: " << strerror(errno);
+            line->SetError("r");
+            return false;
+        }
+        if (TraceWriter) {
+            TraceWriter->WriteLevel(*line, values.values[0], time);
+        }
+        if (values.values[0] != line->GetValueUnfiltered()) {
+            line->HandleEdge(values.values[0], time); // an edge was lost
+            SettleOrScheduleDebounce(line, time);
+        }
+    }
+    return isHandled;
 }
 
-bool TGpioChipDriver::HandleGpioInterrupt(const PGpioLine& line, const TInterruptionContext& ctx)
+bool TGpioChipDriver::HandleGpioInterrupts(int fd, const TGpioLinesByOffsetMap& lines)
 {
     bool isHandled = false;
-    auto fd = line->GetFd();
 
-    fd_set rfds;
-    FD_ZERO(&rfds);
-    FD_SET(fd, &rfds);
-    struct timeval tv{0}; // do not block
+    gpio_v2_line_event events[EVENTS_BATCH_SIZE];
+    size_t count;
+    do {
+        count = ReadEvents(fd, events, EVENTS_BATCH_SIZE);
+        for (size_t i = 0; i < count; ++i) {
+            const auto& event = events[i];
+            auto itLine = lines.find(event.offset);
+            if (itLine == lines.end()) {
+                LOG(Warn) << "Event for unexpected offset " << event.offset << " on " << Chip->Describe();
+                continue;
+            }
 
-    while (auto retVal = select(fd + 1, &rfds, nullptr, nullptr, &tv)) {
-        if (retVal < 0) {
-            LOG(Error) << "select failed: " << strerror(errno);
-            wb_throw(TGpioDriverException,
-                     "unable to read line event data: select failed with " + string(strerror(errno)));
+            // uAPI v2 events are timestamped by CLOCK_MONOTONIC and carry logical line level
+            auto time = TTimePoint(chrono::nanoseconds(event.timestamp_ns));
+            HandleLineEdge(itLine->second, event.id == GPIO_V2_LINE_EVENT_RISING_EDGE, time);
+            isHandled = true;
         }
+    } while (count == EVENTS_BATCH_SIZE); // short read means the queue is drained
 
-        gpioevent_data data{};
-        if (read(fd, &data, sizeof(data)) < 0) {
-            LOG(Error) << "Read gpioevent_data failed: " << strerror(errno);
-            wb_throw(TGpioDriverException,
-                     "unable to read line event data: gpioevent_data failed with " + string(strerror(errno)));
-        }
+    return isHandled;
+}
 
-        auto time = ctx.ToSteadyClock(data.timestamp);
+void TGpioChipDriver::HandleLineEdge(const PGpioLine& line, uint8_t value, const TTimePoint& time)
+{
+    if (line->IsInterruptStorm()) {
+        return; // queued before interrupts of the line were disabled
+    }
+    if (TraceWriter) {
+        TraceWriter->WriteEdge(*line, value, time);
+    }
+    line->HandleEdge(value, time); // record interrupt time, prolong debounce window
+    SettleOrScheduleDebounce(line, time);
 
-        gpiohandle_data values;
-        if (ioctl(fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &values) < 0) {
-            LOG(Error) << "GPIOHANDLE_GET_LINE_VALUES_IOCTL failed: " << strerror(errno);
-            line->SetError("r");
+    if (line->CountEdge(time)) {
+        StartInterruptStorm(line);
+    }
+}
+
+void TGpioChipDriver::StartInterruptStorm(const PGpioLine& line)
+{
+    auto now = Clock->Now();
+    auto reenableTime = line->StartInterruptStorm(now);
+    UpdateLineInterrupts(line);
+    LOG(Warn) << "Edge rate of " << line->DescribeShort() << " exceeds " << line->GetConfig()->MaxEdgeRate
+              << " per second, its interrupts are disabled for "
+              << chrono::duration_cast<chrono::seconds>(line->GetInterruptStormGuard()->GetQuietPeriod()).count()
+              << "s, the line is polled";
+    StormQueue.Schedule(line, min(now + PollConfig.Interval, reenableTime));
+}
+
+void TGpioChipDriver::EndInterruptStorm(const PGpioLine& line, const TTimePoint& now)
+{
+    line->EndInterruptStorm(now);
+    if (UpdateLineInterrupts(line)) {
+        LOG(Info) << "Interrupts of " << line->DescribeShort() << " are enabled back";
+        return;
+    }
+    line->StartInterruptStorm(now); // polled for a longer quiet period
+    UpdateLineInterrupts(line);
+}
+
+bool TGpioChipDriver::UpdateLineInterrupts(const PGpioLine& line)
+{
+    auto fd = line->GetFd();
+    if (MultiLineEventRequests.count(fd)) {
+        // the request keeps lines of its config: debounced by kernel are those that kernel has accepted
+        auto config = MakeV2LineConfig(Lines.at(fd), [](const PGpioLine& line) { return line->IsDebouncedByKernel(); });
+        if (Backend->SetLineConfig(fd, config) < 0) {
+            LOG(Error) << "GPIO_V2_LINE_SET_CONFIG_IOCTL failed: " << strerror(errno) << " at "
+                       << line->DescribeShort();
             return false;
         }
+        return true;
+    }
 
-        line->SetCachedValueUnfiltered(values.values[0]);
-        line->HandleInterrupt(time); // record interrupt time, (re)arm debounce window
-        SetIntervalTimer(line->GetTimerFd(), line->GetConfig()->DebounceTimeout);
-        isHandled = true;
+    /* uAPI v1 event request can't be reconfigured, so while interrupts are disabled the line is requested
+       without events: the kernel doesn't take its IRQs and doesn't queue its events meanwhile.
+       If the line can't be requested as wanted, it is requested the other way not to be lost */
+    auto itSource = find_if(EpollSources.begin(), EpollSources.end(), [fd](const TEpollSource& source) {
+        return source.Fd == fd;
+    });
+    if (itSource == EpollSources.end()) {
+        LOG(Error) << "No epoll source of " << line->DescribeShort();
+        return false;
     }
-    return isHandled;
+    if (fd >= 0) {
+        Lines.erase(fd);
+        Backend->Close(fd); // removes it from epoll as well
+    }
+
+    bool isStorm = line->IsInterruptStorm();
+    bool isRequested = isStorm ? InitInputHandle(line) : TryListenLine(line);
+    if (!isRequested && !(isStorm ? TryListenLine(line) : InitInputHandle(line))) {
+        LOG(Error) << "Unable to request " << line->DescribeShort() << " again";
+        line->SetFd(-1);
+    }
+    itSource->Fd = line->GetFd();
+    if (!isRequested || isStorm) {
+        return isRequested;
+    }
+
+    struct epoll_event ep_event{};
+    ep_event.events = EPOLLIN | EPOLLPRI;
+    ep_event.data.ptr = &*itSource;
+    if (epoll_ctl(Epfd, EPOLL_CTL_ADD, itSource->Fd, &ep_event) < 0) {
+        LOG(Error) << "epoll_ctl error: '" << strerror(errno) << "' at " << line->DescribeShort();
+        return false;
+    }
+    return true;
 }
 
-bool TGpioChipDriver::HandleTimerInterrupt(const PGpioLine& line)
+bool TGpioChipDriver::HandleStormTimerInterrupt()
 {
     bool isHandled = false;
 
-    if (line->UpdateIfStable(chrono::steady_clock::now())) {
-        isHandled = true;
-        SetIntervalTimer(line->GetTimerFd(),
-                         std::chrono::microseconds(0)); // disarm timer
+    auto now = Clock->Now();
+    StormQueue.HandleExpired(now, [&](const PGpioLine& line) {
+        ReadStormLine(line, now);
+        if (line->GetInterruptStormGuard()->GetReenableTime() <= now) {
+            EndInterruptStorm(line, now);
+        }
+        if (line->IsInterruptStorm()) {
+            StormQueue.Schedule(line,
+                                min(now + PollConfig.Interval, line->GetInterruptStormGuard()->GetReenableTime()));
+        }
+        isHandled |= line->IsDirty();
+    });
+    return isHandled;
+}
+
+void TGpioChipDriver::ReadStormLine(const PGpioLine& line, const TTimePoint& now)
+{
+    auto fd = line->GetFd();
+    auto itLines = Lines.find(fd);
+    if (itLines == Lines.end()) {
+        return; // failed to be requested again, it is retried when the storm ends
+    }
+    const auto& lines = itLines->second;
+
+    uint64_t values;
+    if (!GetFdValues(fd, lines.size(), values)) {
+        return; // readback of the line detects disconnection
+    }
+    auto i = find(lines.begin(), lines.end(), line) - lines.begin();
+    uint8_t value = (values >> i) & 1;
+
+    if (TraceWriter) {
+        TraceWriter->WriteLevel(*line, value, now);
+    }
+    if (value != line->GetValueUnfiltered()) {
+        line->HandleEdge(value, now);
+        SettleOrScheduleDebounce(line, now);
+    }
+}
+
+void TGpioChipDriver::SettleOrScheduleDebounce(const PGpioLine& line, const TTimePoint& time)
+{
+    if (line->IsCommittedOnEdge()) {
+        // kernel reports only settled levels or debounce is off: commit and count in this wakeup, no timer
+        line->UpdateIfStable(time);
+        ScheduleCounterUpdate(line, time);
+    } else if (line->GetDebounceDeadline() < line->GetScheduledDebounceDeadline()) {
+        // first edge of the window or the new level settles earlier (asymmetric debounce, sampling filters)
+        ScheduleDebounce(line);
+    }
+}
+
+void TGpioChipDriver::ScheduleDebounce(const PGpioLine& line)
+{
+    auto deadline = line->GetDebounceDeadline();
+    line->SetScheduledDebounceDeadline(deadline);
+    DebounceQueue.Advance(line, deadline); // one deadline per line, so reserved room is enough
+}
+
+void TGpioChipDriver::ScheduleCounterUpdate(const PGpioLine& line, const TTimePoint& now)
+{
+    if (!line->GetCounter() || line->IsCounterUpdatePending()) {
+        return;
     }
+    auto deadline = line->GetCounterUpdateDeadline(now);
+    if (deadline != TTimePoint::max()) {
+        line->SetCounterUpdatePending(true);
+        CounterQueue.Schedule(line, deadline);
+    }
+}
+
+bool TGpioChipDriver::HandleCounterTimerInterrupt()
+{
+    bool isHandled = false;
+
+    auto now = Clock->Now();
+    CounterQueue.HandleExpired(now, [&](const PGpioLine& line) {
+        line->SetCounterUpdatePending(false);
+        line->Update(now);
+        isHandled |= line->IsDirty();
+        ScheduleCounterUpdate(line, now);
+    });
+    return isHandled;
+}
+
+bool TGpioChipDriver::HandleTimerInterrupt()
+{
+    bool isHandled = false;
+
+    auto now = Clock->Now();
+    DebounceQueue.HandleExpired(now, [&](const PGpioLine& line) {
+        if (line->GetScheduledDebounceDeadline() > now) {
+            // the entry outlived a debounce settled without it, the later one of a new window is still due
+            if (line->IsDebouncePending()) {
+                DebounceQueue.Schedule(line, line->GetScheduledDebounceDeadline());
+            }
+            return;
+        }
+        line->SetScheduledDebounceDeadline(TTimePoint::max());
+        if (line->UpdateIfStable(now)) {
+            ScheduleCounterUpdate(line, now);
+            isHandled = true;
+        } else {
+            // edges arrived after the deadline was scheduled: wait for the prolonged window
+            ScheduleDebounce(line);
+        }
+    });
     return isHandled;
 }
 
@@ -270,42 +661,151 @@ bool TGpioChipDriver::HandleInterrupt(const TInterruptionContext& ctx)
     bool isHandled = false;
 
     for (int i = 0; i < ctx.Count; i++) {
-        auto fd = ctx.Events[i].data.fd;
-
-        // gpio interrupt event fired: set stable-val-check timer
-        auto itFdLines = Lines.find(fd);
-        if (itFdLines != Lines.end()) {
-            const auto& lines = itFdLines->second;
-            assert(lines.size() == 1);
-            const auto& line = lines.front();
-            HandleGpioInterrupt(line, ctx);
+        const auto* source = static_cast<const TEpollSource*>(ctx.Events[i].data.ptr);
+        isHandled |= source->Handle(ctx);
+    }
+    return isHandled;
+}
 
-            // timer event fired: check, is value stable or bouncing
-        } else {
-            auto itFdTimers = Timers.find(fd);
-            if (itFdTimers != Timers.end()) {
-                const auto& line = itFdTimers->second.front();
-                isHandled |= HandleTimerInterrupt(line);
-            }
+bool TGpioChipDriver::HandleTimers()
+{
+    bool isHandled = HandleTimerInterrupt();
+    isHandled |= HandleCounterTimerInterrupt();
+    isHandled |= HandleStormTimerInterrupt();
+    if (PollTimerFd >= 0) {
+        auto now = Clock->Now();
+        if (PollDeadline <= now) {
+            isHandled |= PollDueInputs(now);
         }
     }
     return isHandled;
 }
 
+TTimePoint TGpioChipDriver::GetNextTimerDeadline() const
+{
+    auto deadline = min({DebounceQueue.GetEarliestDeadline(),
+                         CounterQueue.GetEarliestDeadline(),
+                         StormQueue.GetEarliestDeadline()});
+    if (PollTimerFd >= 0) {
+        deadline = min(deadline, PollDeadline);
+    }
+    return deadline;
+}
+
+TTimerQueue::TLatencyStats TGpioChipDriver::TakeWakeupLatencyStats()
+{
+    auto stats = DebounceQueue.TakeLatencyStats();
+    stats.Add(CounterQueue.TakeLatencyStats());
+    stats.Add(StormQueue.TakeLatencyStats());
+    return stats;
+}
+
+bool TGpioChipDriver::IsPolledInput(int fd) const
+{
+    return any_of(PolledInputs.begin(), PolledInputs.end(), [fd](const TPolledInput& input) {
+        return input.Fd == fd;
+    });
+}
+
+chrono::milliseconds TGpioChipDriver::GetPollInterval(const TGpioLines& lines, const TTimePoint& now) const
+{
+    if (PollConfig.FastInterval == chrono::milliseconds::zero()) {
+        return PollConfig.Interval;
+    }
+    // the whole request is read at once, so it is read fast while any of its lines is active
+    for (const auto& line: lines) {
+        if (now - line->GetInterruptionTimepoint() < PollConfig.FastHold) {
+            return PollConfig.FastInterval;
+        }
+    }
+    return PollConfig.Interval;
+}
+
+void TGpioChipDriver::ArmPollTimer()
+{
+    PollDeadline = TTimePoint::max();
+    for (const auto& input: PolledInputs) {
+        PollDeadline = min({PollDeadline, input.NextPoll, input.SettleDeadline});
+    }
+    if (Clock->IsSimulated()) {
+        return;
+    }
+
+    auto sinceEpoch = PollDeadline.time_since_epoch();
+    auto sec = chrono::floor<chrono::seconds>(sinceEpoch);
+
+    itimerspec ts{};
+    ts.it_value.tv_sec = sec.count();
+    ts.it_value.tv_nsec = chrono::duration_cast<chrono::nanoseconds>(sinceEpoch - sec).count();
+
+    if (timerfd_settime(PollTimerFd, TFD_TIMER_ABSTIME, &ts, nullptr) < 0) {
+        wb_throw(TGpioDriverException,
+                 "unable to arm poll timer: timerfd_settime failed with " + string(strerror(errno)));
+    }
+}
+
+bool TGpioChipDriver::HandlePollTimerInterrupt()
+{
+    uint64_t expirations = 0;
+    if (read(PollTimerFd, &expirations, sizeof(expirations)) < 0) {
+        if (errno != EAGAIN) {
+            LOG(Error) << "Poll timer read failed: " << strerror(errno);
+        }
+        return false;
+    }
+    return PollDueInputs(Clock->Now());
+}
+
+bool TGpioChipDriver::PollDueInputs(const TTimePoint& now)
+{
+    /* Every request due is read at this wakeup. Next deadlines are counted from the previous ones,
+       not from now, so requests polled at the same rate stay due together and don't drift.
+       A changed level is confirmed by an extra sample at its debounce deadline, not a whole interval later,
+       extra samples don't move the regular ones */
+    bool isChanged = false;
+    for (auto& input: PolledInputs) {
+        if (input.NextPoll > now && input.SettleDeadline > now) {
+            continue;
+        }
+        isChanged |= PollInputValues(input);
+        if (input.NextPoll > now) {
+            continue;
+        }
+
+        auto interval = GetPollInterval(Lines.at(input.Fd), now);
+        input.NextPoll += interval;
+        if (input.NextPoll <= now) {
+            input.NextPoll = now + interval; // too late to keep the pace, don't read in a burst
+        }
+    }
+
+    ArmPollTimer();
+    return isChanged;
+}
+
 bool TGpioChipDriver::PollLines()
 {
-    bool isHandled = false;
+    bool isChanged = false;
 
     for (const auto& fdLines: Lines) {
         const auto& lines = fdLines.second;
         assert(!lines.empty());
 
-        isHandled = true;
-
-        PollLinesValues(lines);
+        if (IsPolledInput(fdLines.first)) {
+            continue;
+        }
+        if (any_of(lines.begin(), lines.end(), [](const PGpioLine& line) { return line->NeedsPolling(); })) {
+            isChanged |= PollLinesValues(lines);
+        }
     }
 
-    return isHandled;
+    return isChanged;
+}
+
+bool TGpioChipDriver::NeedsPolling() const
+{
+    // counted by lines as their errors, requests and interrupt support change, so lane worker checks it at every wakeup
+    return Chip && Chip->GetReadbackLineCount() > 0;
 }
 
 void TGpioChipDriver::ForEachLine(const TGpioLineHandler& handler) const
@@ -320,6 +820,17 @@ void TGpioChipDriver::ForEachLine(const TGpioLineHandler& handler) const
     }
 }
 
+void TGpioChipDriver::ForEachDirtyLine(const TGpioLineHandler& handler) const
+{
+    FOR_EACH_LINE(this, line)
+    {
+        if (line->IsDirty()) {
+            handler(line);
+            line->ClearDirty();
+        }
+    });
+}
+
 bool TGpioChipDriver::ReleaseLineIfUsed(const PGpioLine& line)
 {
     if (!line->IsUsed())
@@ -363,25 +874,102 @@ bool TGpioChipDriver::TryListenLine(const PGpioLine& line)
 
     req.eventflags = GPIOEVENT_REQUEST_BOTH_EDGES;
 
+    if (config->KernelDebounce) {
+        LOG(Info) << "Kernel debounce is not available for " << line->DescribeShort()
+                  << " (GPIO uAPI v2 is required). Userspace debounce will be used";
+    }
+
     errno = 0;
-    if (ioctl(Chip->GetFd(), GPIO_GET_LINEEVENT_IOCTL, &req) < 0) {
+    if (Backend->RequestLineEvent(Chip->GetFd(), req) < 0) {
         auto error = errno;
         LOG(Warn) << "GPIO_GET_LINEEVENT_IOCTL failed: " << strerror(error) << " at " << line->DescribeShort();
         return false;
     }
 
+    SetNonBlocking(req.fd);
     Lines[req.fd].push_back(line);
     assert(Lines[req.fd].size() == 1);
     line->SetFd(req.fd);
 
-    auto timerFd = CreateIntervalTimer();
-    line->SetTimerFd(timerFd);
-    Timers[timerFd].push_back(line);
-
     LOG(Debug) << "Listening to " << line->DescribeShort();
     return true;
 }
 
+bool TGpioChipDriver::TryListenLines(const TGpioLines& lines)
+{
+    assert(!lines.empty() && lines.size() <= GPIO_V2_LINES_MAX);
+
+    gpio_v2_line_request req{};
+
+    strcpy(req.consumer, CONSUMER);
+    req.config = MakeV2LineConfig(lines, [](const PGpioLine& line) {
+        const auto& config = line->GetConfig();
+        return config->KernelDebounce && config->DebounceTimeout.count() > 0;
+    });
+    for (const auto& line: lines) {
+        assert(line->GetConfig()->Direction == EGpioDirection::Input);
+        req.offsets[req.num_lines++] = line->GetOffset();
+    }
+
+    if (Backend->RequestLines(Chip->GetFd(), req) < 0) {
+        auto error = errno;
+        if (req.config.num_attrs == 0) {
+            LOG(Warn) << "GPIO_V2_GET_LINE_IOCTL failed: " << strerror(error) << " for " << lines.size()
+                      << " line(s) of " << Chip->Describe() << ". Trying to listen lines one by one";
+            return false;
+        }
+
+        LOG(Warn) << "GPIO_V2_GET_LINE_IOCTL with debounce failed: " << strerror(error) << " for " << lines.size()
+                  << " line(s) of " << Chip->Describe() << ". Userspace debounce will be used";
+        req.config.num_attrs = 0;
+        if (Backend->RequestLines(Chip->GetFd(), req) < 0) {
+            LOG(Warn) << "GPIO_V2_GET_LINE_IOCTL failed: " << strerror(errno) << " for " << lines.size()
+                      << " line(s) of " << Chip->Describe() << ". Trying to listen lines one by one";
+            return false;
+        }
+    }
+
+    SetNonBlocking(req.fd);
+    auto& requestLines = MultiLineEventRequests[req.fd];
+    for (const auto& line: lines) {
+        Lines[req.fd].push_back(line);
+        requestLines[line->GetOffset()] = line;
+        line->SetFd(req.fd);
+        line->SetInterruptSupport(EInterruptSupport::YES);
+        LOG(Debug) << "Listening to " << line->DescribeShort();
+
+        if (line->GetConfig()->KernelDebounce && req.config.num_attrs > 0) {
+            line->SetDebouncedByKernel(IsKernelDebounceApplied(line));
+            if (line->IsDebouncedByKernel()) {
+                LOG(Info) << "Debounce of " << line->DescribeShort() << " is done by kernel";
+            } else {
+                LOG(Warn) << "Kernel did not accept debounce for " << line->DescribeShort()
+                          << ". Userspace debounce will be used";
+            }
+        }
+    }
+
+    return true;
+}
+
+bool TGpioChipDriver::IsKernelDebounceApplied(const PGpioLine& line) const
+{
+    gpio_v2_line_info info{};
+    info.offset = line->GetOffset();
+
+    if (Backend->GetLineInfo(Chip->GetFd(), info) < 0) {
+        LOG(Error) << "GPIO_V2_GET_LINEINFO_IOCTL failed: " << strerror(errno) << " at " << line->DescribeShort();
+        return false;
+    }
+
+    for (uint32_t i = 0; i < info.num_attrs; ++i) {
+        if (info.attrs[i].id == GPIO_V2_LINE_ATTR_ID_DEBOUNCE) {
+            return info.attrs[i].debounce_period_us == line->GetConfig()->DebounceTimeout.count();
+        }
+    }
+    return false;
+}
+
 bool TGpioChipDriver::FlushMcp23xState(const PGpioLine& line)
 {
     /*
@@ -402,13 +990,13 @@ bool TGpioChipDriver::FlushMcp23xState(const PGpioLine& line)
     req.eventflags |= GPIOEVENT_REQUEST_RISING_EDGE;
     strcpy(req.consumer_label, CONSUMER);
 
-    if (ioctl(Chip->GetFd(), GPIO_GET_LINEEVENT_IOCTL, &req) < 0) {
+    if (Backend->RequestLineEvent(Chip->GetFd(), req) < 0) {
         LOG(Error) << "Temporary init " << line->DescribeShort()
                    << " as input failed. GPIO_GET_LINEEVENT_IOCTL: " << strerror(errno);
         return false;
     }
     line->UpdateInfo();
-    close(req.fd);
+    Backend->Close(req.fd);
     return true;
 }
 
@@ -425,18 +1013,19 @@ bool TGpioChipDriver::InitOutput(const PGpioLine& line, uint8_t val)
     req.flags = GetFlagsFromConfig(*config, line->IsOutput());
     strcpy(req.consumer_label, CONSUMER);
 
-    if (ioctl(Chip->GetFd(), GPIO_GET_LINEHANDLE_IOCTL, &req) < 0) {
+    if (Backend->RequestLineHandle(Chip->GetFd(), req) < 0) {
         LOG(Error) << "GPIO_GET_LINEHANDLE_IOCTL failed: " << strerror(errno) << " at " << line->DescribeShort();
         return false;
     }
 
+    SetNonBlocking(req.fd);
     Lines[req.fd].push_back(line);
     assert(Lines[req.fd].size() == 1);
     line->SetFd(req.fd);
 
     if (Debug.IsEnabled()) {
         gpiohandle_data data;
-        if (ioctl(line->GetFd(), GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) >= 0) {
+        if (Backend->GetLineValues(line->GetFd(), data) >= 0) {
             LOG(Debug) << "Initialized output " << line->DescribeShort() << " = " << static_cast<int>(data.values[0]);
         }
     } else {
@@ -446,6 +1035,29 @@ bool TGpioChipDriver::InitOutput(const PGpioLine& line, uint8_t val)
     return true;
 }
 
+bool TGpioChipDriver::InitInputHandle(const PGpioLine& line)
+{
+    const auto& config = line->GetConfig();
+    assert(config->Direction == EGpioDirection::Input);
+
+    gpiohandle_request req{};
+    req.lines = 1;
+    req.lineoffsets[0] = line->GetOffset();
+    req.flags = GetFlagsFromConfig(*config);
+    strcpy(req.consumer_label, CONSUMER);
+
+    if (Backend->RequestLineHandle(Chip->GetFd(), req) < 0) {
+        LOG(Error) << "GPIO_GET_LINEHANDLE_IOCTL failed: " << strerror(errno) << " at " << line->DescribeShort();
+        return false;
+    }
+
+    SetNonBlocking(req.fd);
+    Lines[req.fd].push_back(line);
+    assert(Lines[req.fd].size() == 1);
+    line->SetFd(req.fd);
+    return true;
+}
+
 bool TGpioChipDriver::InitInputInterrupts(const PGpioLine& line)
 {
     switch (line->GetInterruptSupport()) {
@@ -481,7 +1093,7 @@ bool TGpioChipDriver::InitLinesPolling(uint32_t flags, const vector<PGpioLine>&
         ++req.lines;
     }
 
-    if (ioctl(Chip->GetFd(), GPIO_GET_LINEHANDLE_IOCTL, &req) < 0) {
+    if (Backend->RequestLineHandle(Chip->GetFd(), req) < 0) {
         LOG(Error) << "GPIO_GET_LINEHANDLE_IOCTL failed: " << strerror(errno);
         return false;
     }
@@ -495,34 +1107,148 @@ bool TGpioChipDriver::InitLinesPolling(uint32_t flags, const vector<PGpioLine>&
         line->SetFd(req.fd);
         initialized.push_back(line);
     }
+    PolledInputs.push_back({req.fd, TTimePoint::max(), 0, 0, TTimePoint::max(), false});
 
     return true;
 }
 
-void TGpioChipDriver::PollLinesValues(const TGpioLines& lines)
+bool TGpioChipDriver::GetFdValues(int fd, size_t lineCount, uint64_t& bits) const
 {
-    assert(!lines.empty());
+    uint64_t mask = (lineCount == 64) ? ~0ULL : ((1ULL << lineCount) - 1);
 
-    auto fd = lines.front()->GetFd();
-    gpiohandle_data data;
-    if (ioctl(fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0) {
-        if (lines.front()->GetError().empty()) {
+    if (MultiLineEventRequests.count(fd) == 0) {
+        gpiohandle_data data;
+        if (Backend->GetLineValues(fd, data) < 0) {
             LOG(Error) << "GPIOHANDLE_GET_LINE_VALUES_IOCTL failed: " << strerror(errno);
-            for (const auto& line: lines) {
-                LOG(Error) << "Treating " << line->DescribeShort() << " as disconnected";
-                line->SetError("r");
-            }
+            return false;
         }
-        return;
+        bits = 0;
+        for (size_t i = 0; i < lineCount; ++i) {
+            bits |= static_cast<uint64_t>(data.values[i] != 0) << i;
+        }
+        return true;
+    }
+
+    gpio_v2_line_values values{};
+    values.mask = mask;
+    if (Backend->GetLineValues(fd, values) < 0) {
+        LOG(Error) << "GPIO_V2_LINE_GET_VALUES_IOCTL failed: " << strerror(errno);
+        return false;
+    }
+    bits = values.bits & mask;
+    return true;
+}
+
+bool TGpioChipDriver::SetReadError(const TGpioLines& lines)
+{
+    if (!lines.front()->GetError().empty()) {
+        return false;
+    }
+    for (const auto& line: lines) {
+        LOG(Error) << "Treating " << line->DescribeShort() << " as disconnected";
+        line->SetError("r");
+    }
+    return true;
+}
+
+bool TGpioChipDriver::PollInputValues(TPolledInput& input)
+{
+    const auto& lines = Lines.at(input.Fd);
+
+    if (!input.IsSynced) {
+        // first poll and recovery from errors go line by line
+        bool isChanged = PollLinesValues(lines);
+        input.IsSynced = all_of(lines.begin(), lines.end(), [](const PGpioLine& line) {
+            return line->GetError().empty();
+        });
+        input.Values = 0;
+        for (size_t i = 0; i < lines.size(); ++i) {
+            input.Values |= static_cast<uint64_t>(lines[i]->GetValueUnfiltered() != 0) << i;
+        }
+        UpdatePendingSamples(input);
+        return isChanged;
     }
 
-    auto now = chrono::steady_clock::now();
+    uint64_t values;
+    if (!GetFdValues(input.Fd, lines.size(), values)) {
+        input.IsSynced = false;
+        return SetReadError(lines);
+    }
+
+    // snapshot matches unfiltered values of lines, so only lines of set bits have changed
+    auto changed = values ^ input.Values;
+    auto sampled = changed | input.Pending;
+    if (sampled == 0) {
+        return false;
+    }
+    input.Values = values;
+
+    auto now = Clock->Now();
+    if (TraceWriter) {
+        TraceWriter->WritePollSample(lines, values, now);
+    }
+    bool isChanged = false;
+    do {
+        auto i = __builtin_ctzll(sampled);
+        sampled &= sampled - 1;
+
+        const auto& line = lines[i];
+        uint8_t value = (values >> i) & 1;
+        if ((changed >> i) & 1) {
+            LOG(Debug) << "Poll " << line->DescribeShort() << " new value: " << static_cast<int>(value);
+        }
+        isChanged |= HandleInputSample(line, value, now);
+    } while (sampled);
+
+    UpdatePendingSamples(input);
+    return isChanged;
+}
+
+void TGpioChipDriver::UpdatePendingSamples(TPolledInput& input) const
+{
+    const auto& lines = Lines.at(input.Fd);
+
+    input.Pending = 0;
+    input.SettleDeadline = TTimePoint::max();
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (lines[i]->IsDebouncePending()) {
+            input.Pending |= 1ULL << i;
+            input.SettleDeadline = min(input.SettleDeadline, lines[i]->GetScheduledDebounceDeadline());
+        }
+    }
+}
+
+bool TGpioChipDriver::HandleInputSample(const PGpioLine& line, uint8_t value, const TTimePoint& now)
+{
+    if (!line->HandleSample(value, now)) {
+        return false;
+    }
+    ScheduleCounterUpdate(line, now);
+    return line->IsDirty();
+}
+
+bool TGpioChipDriver::PollLinesValues(const TGpioLines& lines)
+{
+    assert(!lines.empty());
+
+    auto fd = lines.front()->GetFd();
+    uint64_t values;
+    if (!GetFdValues(fd, lines.size(), values)) {
+        return SetReadError(lines);
+    }
+
+    bool isChanged = false;
+
+    auto now = Clock->Now();
+    if (TraceWriter) {
+        TraceWriter->WritePollSample(lines, values, now);
+    }
     for (uint32_t i = 0; i < lines.size(); ++i) {
         const auto& line = lines[i];
         assert(line->GetFd() == fd);
 
         bool oldValue = line->GetValue();
-        bool newValue = data.values[i];
+        bool newValue = (values >> i) & 1;
 
         bool recovery = !line->GetError().empty();
         if (recovery) {
@@ -536,16 +1262,28 @@ void TGpioChipDriver::PollLinesValues(const TGpioLines& lines)
         LOG(Debug) << "Poll " << line->DescribeShort() << " old value: " << oldValue << " new value: " << newValue;
 
         if (!line->IsOutput()) {
-            /* if value changed for input we simulate interrupt */
-            if (recovery || oldValue != newValue) {
+            if (recovery) {
+                // level after an error is taken as is, it is not a change to debounce or count
+                line->SetScheduledDebounceDeadline(TTimePoint::max());
                 line->HandleInterrupt(now);
+                line->SetCachedValueUnfiltered(newValue);
                 line->SetCachedValue(newValue);
+            } else if (line->GetInterruptSupport() == EInterruptSupport::YES) {
+                if (newValue != line->GetValueUnfiltered()) {
+                    line->HandleEdge(newValue, now); // an edge was lost
+                    SettleOrScheduleDebounce(line, now);
+                }
+            } else {
+                HandleInputSample(line, newValue, now);
             }
         } else { /* for output just set value to cache: it will publish it if
                     changed */
             line->SetCachedValue(newValue);
         }
+
+        isChanged |= line->IsDirty();
     }
+    return isChanged;
 }
 
 void TGpioChipDriver::ReadLinesValues(const TGpioLines& lines)
@@ -555,20 +1293,23 @@ void TGpioChipDriver::ReadLinesValues(const TGpioLines& lines)
     }
     auto fd = lines.front()->GetFd();
 
-    gpiohandle_data data;
-    if (ioctl(fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0) {
-        LOG(Error) << "GPIOHANDLE_GET_LINE_VALUES_IOCTL failed: " << strerror(errno);
+    // lines may be a subset of lines requested by fd, so find their positions in request
+    const auto& fdLines = Lines.at(fd);
+
+    uint64_t values;
+    if (!GetFdValues(fd, fdLines.size(), values)) {
         for (const auto& line: lines) {
             line->SetError("r");
         }
         return;
     }
 
-    uint32_t i = 0;
     for (const auto& line: lines) {
         assert(line->GetFd() == fd);
 
-        line->SetCachedValue(data.values[i++]);
+        auto i = find(fdLines.begin(), fdLines.end(), line) - fdLines.begin();
+        line->SetCachedValue((values >> i) & 1);
+        line->SetCachedValueUnfiltered((values >> i) & 1);
     }
 }
 
@@ -577,13 +1318,16 @@ void TGpioChipDriver::ReListenLine(PGpioLine line)
     assert(!AddedToEpoll);
 
     auto oldFd = line->GetFd();
-    auto oldTimerFd = line->GetTimerFd();
 
     assert(oldFd > -1);
 
+    if (MultiLineEventRequests.count(oldFd)) {
+        LOG(Debug) << line->DescribeShort() << " is listened by multi-line request for both edges, no need to re-listen";
+        return;
+    }
+
     Lines.erase(oldFd);
-    Timers.erase(oldTimerFd);
-    close(oldFd);
+    Backend->Close(oldFd);
 
     bool ok = TryListenLine(line);
     assert(ok);
@@ -596,7 +1340,7 @@ void TGpioChipDriver::ReInitOutput(PGpioLine line)
 {
     auto oldfd = line->GetFd();
     Lines.erase(oldfd);
-    close(oldfd);
+    Backend->Close(oldfd);
 
     if (Chip->GetLabel() == "mcp23017" || Chip->GetLabel() == "mcp23008")
         if (!FlushMcp23xState(line)) {
@@ -682,3 +1426,26 @@ void TGpioChipDriver::ReadInputValues()
         ReadLinesValues(linesToRead);
     }
 }
+
+void TGpioChipDriver::MeasureReadLatency()
+{
+    // chips behind a bus may answer slower than usual once, so each request is read several times.
+    // Latency is real time of ioctls, even if the driver runs by simulated clock
+    const auto probeCount = 3;
+
+    for (const auto& fdLines: Lines) {
+        for (auto i = 0; i < probeCount; ++i) {
+            uint64_t values;
+            auto start = chrono::steady_clock::now();
+            if (!GetFdValues(fdLines.first, fdLines.second.size(), values)) {
+                break;
+            }
+            ReadLatency = max<chrono::nanoseconds>(ReadLatency, chrono::steady_clock::now() - start);
+        }
+    }
+}
+
+chrono::nanoseconds TGpioChipDriver::GetReadLatency() const
+{
+    return ReadLatency;
+}
@@ -1,30 +1,69 @@
 #pragma once
 
+#include "clock.h"
+#include "config.h"
 #include "declarations.h"
+#include "gpio_backend.h"
+#include "timer_queue.h"
 #include "types.h"
 
 #include <functional>
+#include <linux/gpio.h>
 #include <unordered_map>
 #include <vector>
 
 using TGpioLinesByOffsetMap = std::unordered_map<uint32_t, PGpioLine>;
 
+/* Handler of one fd added to epoll. Passed in epoll_event.data.ptr, so the worker
+   dispatches a ready fd straight to its handler */
+struct TEpollSource
+{
+    int Fd;
+    std::function<bool(const TInterruptionContext&)> Handle;
+};
+
 class TGpioChipDriver
 {
     using TGpioLines = std::vector<PGpioLine>;
     using TGpioLinesMap = std::unordered_map<int, TGpioLines>;
-    using TGpioTimersMap = std::unordered_map<int, TGpioLines>;
     using TGpioLinesByOffsetMap = std::unordered_map<uint32_t, PGpioLine>;
 
+    /* Request of inputs without interrupts: all its lines are read by one ioctl */
+    struct TPolledInput
+    {
+        int Fd;
+        TTimePoint NextPoll;
+        uint64_t Values;           // last sample, bit per line, in order of request
+        uint64_t Pending;          // lines with a level waiting for a settling sample
+        TTimePoint SettleDeadline; // the earliest debounce deadline of Pending lines
+        bool IsSynced;             // Values match unfiltered values of lines and none of them has error
+    };
+
     TGpioLinesByOffsetMap InitiallyDisconnectedLines;
-    TGpioTimersMap Timers;
+    std::unordered_map<int, TGpioLinesByOffsetMap> MultiLineEventRequests; // uAPI v2 request fd => its lines
+    TTimerQueue DebounceQueue;
+    TTimerQueue CounterQueue; // deadlines of counters' current value decay
+    TTimerQueue StormQueue;   // polls of lines with interrupts disabled by edge storm
+    std::vector<TEpollSource> EpollSources; // must not reallocate once added to epoll
+    std::vector<TPolledInput> PolledInputs; // read by poll timer
+    int PollTimerFd;
+    TTimePoint PollDeadline;
+    TGpioPollConfig PollConfig;
+    std::chrono::nanoseconds ReadLatency;
+    PGpioBackend Backend;
+    PClock Clock;
     PGpioChip Chip;
+    TEdgeTraceWriter* TraceWriter; // records line events if set
+    int Epfd; // the driver is added to, -1 - none
     bool AddedToEpoll;
+    bool ReadLevelAfterEvents; // uAPI v1 event id is not trusted as line level, read it by ioctl
 
 public:
     using TGpioLineHandler = std::function<void(const PGpioLine&)>;
 
-    explicit TGpioChipDriver(const TGpioChipConfig&);
+    explicit TGpioChipDriver(const TGpioChipConfig&,
+                             const PGpioBackend& backend = GetKernelGpioBackend(),
+                             const PClock& clock = GetSteadyClock());
     explicit TGpioChipDriver();
     ~TGpioChipDriver();
 
@@ -32,32 +71,82 @@ public:
     const TGpioLinesByOffsetMap& MapInitiallyDisconnectedLinesByOffset() const;
 
     void AddToEpoll(int epfd);
-    bool HandleInterrupt(const TInterruptionContext&);
 
-    int CreateIntervalTimer();
-    void SetIntervalTimer(int tfd, std::chrono::microseconds intervalUs);
+    /* Records edges and poll samples of lines to trace. Writer must outlive the driver */
+    void SetTraceWriter(TEdgeTraceWriter* writer);
+
+    /* Dispatches ready events of all chip drivers added to the same epoll */
+    static bool HandleInterrupt(const TInterruptionContext&);
+
+    /* Handles debounce, counter and poll deadlines expired by now of the clock.
+       The only way to handle them with simulated clock, as its timers are not armed */
+    bool HandleTimers();
 
+    /* Earliest deadline of debounce, counter and poll timers, TTimePoint::max() if there is none */
+    TTimePoint GetNextTimerDeadline() const;
+
+    /* Reads back lines that are not read by poll timer: outputs, interrupt inputs and lines with errors */
     bool PollLines();
 
+    /* true if PollLines() has something to read */
+    bool NeedsPolling() const;
+
+    /* Max duration of reading line values measured at initialization */
+    std::chrono::nanoseconds GetReadLatency() const;
+
+    /* Returns delays of timer wakeups collected since previous call */
+    TTimerQueue::TLatencyStats TakeWakeupLatencyStats();
+
     void ForEachLine(const TGpioLineHandler&) const;
 
+    /* Calls handler only for lines changed since previous call and marks them clean */
+    void ForEachDirtyLine(const TGpioLineHandler&) const;
+
 private:
     bool ReleaseLineIfUsed(const PGpioLine&);
     bool TryListenLine(const PGpioLine&);
+    bool TryListenLines(const TGpioLines&);
+    bool IsKernelDebounceApplied(const PGpioLine&) const;
     bool InitOutput(const PGpioLine&, uint8_t);
+    bool InitInputHandle(const PGpioLine&); // requests input without events, only to read it
     bool FlushMcp23xState(const PGpioLine&);
     bool InitInputInterrupts(const PGpioLine&);
     bool InitLinesPolling(uint32_t flags, const TGpioLines& lines);
 
-    void PollLinesValues(const TGpioLines&);
+    /* Reads values of request lines packed into bits, in order of request */
+    bool GetFdValues(int fd, size_t lineCount, uint64_t& bits) const;
+    bool SetReadError(const TGpioLines&); // returns false if lines are already treated as disconnected
+    bool PollInputValues(TPolledInput&);
+    void UpdatePendingSamples(TPolledInput&) const;
+    bool HandleInputSample(const PGpioLine& line, uint8_t value, const TTimePoint& now);
+    bool PollLinesValues(const TGpioLines&);
     virtual void ReadLinesValues(const TGpioLines&);
 
     virtual void ReListenLine(PGpioLine);
     virtual void ReInitOutput(PGpioLine);
     void ReadInputValues();
-
-    bool HandleTimerInterrupt(const PGpioLine&);
-    bool HandleGpioInterrupt(const PGpioLine& line, const TInterruptionContext& ctx);
+    void MeasureReadLatency();
+
+    bool IsPolledInput(int fd) const;
+    std::chrono::milliseconds GetPollInterval(const TGpioLines& lines, const TTimePoint& now) const;
+    void ArmPollTimer();
+    bool HandlePollTimerInterrupt();
+    bool PollDueInputs(const TTimePoint& now);
+
+    void ScheduleDebounce(const PGpioLine&);
+    void SettleOrScheduleDebounce(const PGpioLine&, const TTimePoint& time);
+    bool HandleTimerInterrupt();
+    void ScheduleCounterUpdate(const PGpioLine&, const TTimePoint& now);
+    bool HandleCounterTimerInterrupt();
+    bool HandleGpioInterrupt(int fd, const PGpioLine& line);
+    bool HandleGpioInterrupts(int fd, const TGpioLinesByOffsetMap& lines);
+    void HandleLineEdge(const PGpioLine& line, uint8_t value, const TTimePoint& time);
+
+    void StartInterruptStorm(const PGpioLine&);
+    void EndInterruptStorm(const PGpioLine&, const TTimePoint& now);
+    bool UpdateLineInterrupts(const PGpioLine&); // disables or enables interrupts by storm state of the line
+    bool HandleStormTimerInterrupt();
+    void ReadStormLine(const PGpioLine&, const TTimePoint& now);
 
 protected:
     TGpioLinesMap Lines;
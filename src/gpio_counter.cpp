@@ -20,6 +20,7 @@ const auto ID_POSTFIX_CURRENT = "_current";
 const auto CURRENT_TIME_INTERVAL = 1;
 const auto NULL_TIME_INTERVAL = 100;
 const auto COUNTER_UPDATE_INTERVAL_US = 200000;
+const auto COUNTER_DECAY_STEP = chrono::milliseconds(500);
 
 TGpioCounter::TGpioCounter(const TGpioLineConfig& config)
     : Multiplier(config.Multiplier),
@@ -80,6 +81,21 @@ void TGpioCounter::Update(const TTimeIntervalUs& interval)
     }
 }
 
+TTimeIntervalUs TGpioCounter::GetNextUpdateInterval(const TTimeIntervalUs& interval) const
+{
+    if (Current.Get() <= 0 || PreviousInterval == TTimeIntervalUs::zero()) {
+        return TTimeIntervalUs::max();
+    }
+
+    // decay starts when there is no pulse for longer than the previous period, and ends with zero
+    auto decayStart = CURRENT_TIME_INTERVAL * PreviousInterval + TTimeIntervalUs(1);
+    auto decayEnd = NULL_TIME_INTERVAL * PreviousInterval + TTimeIntervalUs(1);
+    if (interval < decayStart) {
+        return decayStart;
+    }
+    return min<TTimeIntervalUs>(interval + COUNTER_DECAY_STEP, decayEnd);
+}
+
 float TGpioCounter::GetCurrent() const
 {
     return Current.Get();
@@ -117,6 +133,19 @@ std::string TGpioCounter::GetRoundedTotal() const
     return Utils::SetDecimalPlaces(GetTotal(), DecimalPlacesTotal);
 }
 
+bool TGpioCounter::IsChanged() const
+{
+    std::unique_lock<std::mutex> lk(AccessMutex);
+    return Total.IsChanged() || Current.IsChanged();
+}
+
+void TGpioCounter::ResetChanged()
+{
+    std::unique_lock<std::mutex> lk(AccessMutex);
+    Total.ResetChanged();
+    Current.ResetChanged();
+}
+
 void TGpioCounter::SetInterruptEdge(EGpioEdge edge)
 {
     InterruptEdge = edge;
@@ -36,6 +36,10 @@ public:
     void HandleInterrupt(EGpioEdge, const TTimeIntervalUs& interval);
     void Update(const TTimeIntervalUs&);
 
+    /* Returns interval since last interrupt, at which Update() should be called next.
+       TTimeIntervalUs::max() if current value does not decay anymore */
+    TTimeIntervalUs GetNextUpdateInterval(const TTimeIntervalUs& interval) const;
+
     float GetCurrent() const;
     float GetTotal() const;
     uint64_t GetCounts() const;
@@ -43,6 +47,10 @@ public:
     std::vector<TValuePair> GetIdsAndValues(const std::string& baseId) const;
     std::string GetRoundedTotal() const;
 
+    /* true if total or current value was changed since last ResetChanged() call. Thread safe. */
+    bool IsChanged() const;
+    void ResetChanged();
+
     void SetInterruptEdge(EGpioEdge);
     EGpioEdge GetInterruptEdge() const;
 
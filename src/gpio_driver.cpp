@@ -1,17 +1,19 @@
 #include "gpio_driver.h"
 #include "config.h"
+#include "edge_trace.h"
 #include "exceptions.h"
 #include "gpio_chip_driver.h"
 #include "gpio_counter.h"
 #include "gpio_line.h"
-#include "interruption_context.h"
 #include "log.h"
 
 #include <wblib/wbmqtt.h>
 
+#include <algorithm>
 #include <cassert>
-#include <sys/epoll.h>
-#include <unistd.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/mman.h>
 
 #define LOG(logger) ::logger.Log() << "[gpio driver] "
 
@@ -19,8 +21,6 @@ using namespace std;
 using namespace WBMQTT;
 
 const char* const TGpioDriver::Name = "wb-gpio";
-const auto EPOLL_TIMEOUT_MS = 500;
-const auto EPOLL_EVENT_COUNT = 20;
 
 namespace
 {
@@ -62,9 +62,14 @@ TFuture<PControl> CreateOutputControl(WBMQTT::PLocalDevice device,
     return futureControl;
 }
 
-TGpioDriver::TGpioDriver(const WBMQTT::PDeviceDriver& mqttDriver, const TGpioDriverConfig& config)
+TGpioDriver::TGpioDriver(const WBMQTT::PDeviceDriver& mqttDriver,
+                         const TGpioDriverConfig& config,
+                         const PGpioBackend& backend)
     : MqttDriver(mqttDriver),
-      Active(false)
+      PublisherActive(false),
+      Active(false),
+      WorkerThreads(max(config.WorkerThreads, 1)),
+      LockMemory(config.LockMemory)
 {
     try {
         auto tx = MqttDriver->BeginTx();
@@ -79,20 +84,33 @@ TGpioDriver::TGpioDriver(const WBMQTT::PDeviceDriver& mqttDriver, const TGpioDri
             wb_throw(TGpioDriverException, "no chips defined in config. Nothing to do");
         }
 
+        if (!config.TraceFile.empty()) {
+            TraceWriter = make_unique<TEdgeTraceWriter>(config.TraceFile);
+        }
+
+        size_t shardedChips = 0;
         for (const auto& chipConfig: config.Chips) {
             if (chipConfig.Lines.empty()) {
                 LOG(Warn) << "No lines for chip at '" << chipConfig.Path << "'. Skipping";
                 continue;
             }
 
+            PGpioChipDriver chipDriver;
             try {
-                ChipDrivers.push_back(make_shared<TGpioChipDriver>(chipConfig));
+                chipDriver = make_shared<TGpioChipDriver>(chipConfig, backend);
             } catch (const TGpioDriverException& e) {
                 LOG(Error) << "Failed to create chip driver for " << chipConfig.Path << ": " << e.what();
                 continue;
             }
+            chipDriver->SetTraceWriter(TraceWriter.get());
+
+            auto readLatency = chipDriver->GetReadLatency();
+            auto laneName = ShardLane(TGpioLane::SelectLane(chipConfig.Lane, readLatency), shardedChips);
+            auto lane = GetLane(laneName, config);
+            lane->AddChipDriver(chipDriver);
+            LOG(Info) << "Chip " << chipConfig.Path << " is served by " << lane->GetName() << " lane, read latency "
+                      << chrono::duration_cast<chrono::microseconds>(readLatency).count() << "us";
 
-            const auto& chipDriver = ChipDrivers.back();
             const auto& mappedLines = chipDriver->MapLinesByOffset();
             const auto& mappedDisconnectedLines = chipDriver->MapInitiallyDisconnectedLinesByOffset();
 
@@ -113,6 +131,7 @@ TGpioDriver::TGpioDriver(const WBMQTT::PDeviceDriver& mqttDriver, const TGpioDri
                     line = itDisconnectedLine->second;
                     line->SetError("r");
                 }
+                LineLanes[line.get()] = lane;
 
                 auto futureControl = TPromise<PControl>::GetValueFuture(nullptr);
 
@@ -169,52 +188,24 @@ TGpioDriver::TGpioDriver(const WBMQTT::PDeviceDriver& mqttDriver, const TGpioDri
             }
         }
 
-        if (ChipDrivers.empty()) {
+        if (Lanes.empty()) {
             wb_throw(TGpioDriverException, "Failed to create any chip driver. Nothing to do");
         }
 
+        if (Lanes.size() > 1) {
+            PublishQueue = make_unique<TPublishQueue>();
+            for (const auto& lane: Lanes) {
+                lane->SetPublishQueue(PublishQueue.get());
+            }
+        }
+
     } catch (const exception& e) {
         LOG(Error) << "Unable to create GPIO driver: " << e.what();
         throw;
     }
 
-    EventHandlerHandle = mqttDriver->On<TControlOnValueEvent>([](const TControlOnValueEvent& event) {
-        const auto& line = event.Control->GetUserData().As<PGpioLine>();
-        std::string valueForPublishing;
-        if (line->IsOutput()) {
-            uint8_t value;
-            if (event.RawValue == "1") {
-                value = 1;
-            } else if (event.RawValue == "0") {
-                value = 0;
-            } else {
-                LOG(Warn) << "Invalid value: " << event.RawValue;
-                return;
-            }
-            line->SetValue(value);
-            valueForPublishing = event.RawValue;
-        } else {
-            char* end;
-            float value = strtof(event.RawValue.c_str(), &end);
-            if (end == event.RawValue.c_str()) {
-                LOG(Warn) << "Invalid value: " << event.RawValue;
-                return;
-            }
-            if (line->GetCounter()) {
-                line->GetCounter()->SetInitialValues(value);
-                valueForPublishing = line->GetCounter()->GetRoundedTotal();
-            }
-        }
-
-        auto lineError = line->GetError();
-        if (!lineError.empty()) {
-            event.Control->GetDevice()->GetDriver()->AccessAsync(
-                [=](const PDriverTx& tx) { event.Control->SetError(tx, lineError); });
-        } else {
-            event.Control->GetDevice()->GetDriver()->AccessAsync(
-                [=](const PDriverTx& tx) { event.Control->SetRawValue(tx, valueForPublishing); });
-        }
-    });
+    EventHandlerHandle = mqttDriver->On<TControlOnValueEvent>(
+        [this](const TControlOnValueEvent& event) { EnqueueCommand(event.Control, event.RawValue); });
 }
 
 TGpioDriver::~TGpioDriver()
@@ -225,6 +216,56 @@ TGpioDriver::~TGpioDriver()
     }
 }
 
+TGpioLane* TGpioDriver::GetLane(const std::string& name, const TGpioDriverConfig& config)
+{
+    for (const auto& lane: Lanes) {
+        if (lane->GetName() == name) {
+            return lane.get();
+        }
+    }
+    Lanes.push_back(make_shared<TGpioLane>(name, MqttDriver, config));
+    return Lanes.back().get();
+}
+
+std::string TGpioDriver::ShardLane(const std::string& name, size_t& shardedChips) const
+{
+    if (name != TGpioLane::MAIN || WorkerThreads == 1) {
+        return name;
+    }
+
+    // chips of main lane are spread over worker threads round-robin, thread N is pinned to worker_cpu + N
+    // (see TGpioLane::GetWorkerSchedule). Chips of other lanes don't take turns, so they don't skew the spread
+    auto shard = shardedChips++ % WorkerThreads;
+    return (shard == 0) ? name : name + "-" + to_string(shard);
+}
+
+void TGpioDriver::RunPublisher()
+{
+    pollfd queueFd{PublishQueue->GetFd(), POLLIN, 0};
+    while (PublisherActive) {
+        if (poll(&queueFd, 1, -1) < 0 && errno != EINTR) {
+            LOG(Error) << "poll of publish queue failed: " << strerror(errno);
+        }
+        PublishQueuedChanges();
+    }
+    PublishQueuedChanges(); // last changes of stopped lanes
+}
+
+void TGpioDriver::PublishQueuedChanges()
+{
+    // batches of all lanes pushed so far go to the same transaction
+    PDriverTx tx;
+    PublishQueue->Drain([&](const TControlUpdates& batch) {
+        if (batch.empty()) {
+            return;
+        }
+        if (!tx) {
+            tx = MqttDriver->BeginTx();
+        }
+        TGpioLane::PublishUpdates(tx, batch);
+    });
+}
+
 void TGpioDriver::Start()
 {
     {
@@ -235,66 +276,22 @@ void TGpioDriver::Start()
         Active = true;
     }
 
-    Worker = WBMQTT::MakeThread("GPIO worker", {[this] {
-                                    LOG(Info) << "Started";
-
-                                    int epfd = epoll_create(1); // creating epoll for Interrupts
-                                    struct epoll_event events[EPOLL_EVENT_COUNT]{};
-
-                                    WB_SCOPE_EXIT(close(epfd);)
-
-                                    for (const auto& chipDriver: ChipDrivers) {
-                                        chipDriver->AddToEpoll(epfd);
-                                    }
-
-                                    while (Active) {
-                                        bool isHandled = false;
-                                        if (int count = epoll_wait(epfd, events, EPOLL_EVENT_COUNT, EPOLL_TIMEOUT_MS)) {
-                                            TInterruptionContext ctx{count, events};
-                                            for (const auto& chipDriver: ChipDrivers) {
-                                                isHandled |= chipDriver->HandleInterrupt(ctx);
-                                            }
-                                        } else {
-                                            for (const auto& chipDriver: ChipDrivers) {
-                                                isHandled |= chipDriver->PollLines();
-                                            }
-                                        }
-
-                                        if (!isHandled) {
-                                            continue;
-                                        }
-
-                                        auto tx = MqttDriver->BeginTx();
-                                        auto device = tx->GetDevice(Name);
-
-                                        for (const auto& chipDriver: ChipDrivers) {
-                                            FOR_EACH_LINE(chipDriver, line)
-                                            {
-                                                line->Update();
-
-                                                const auto err = line->GetError();
-                                                if (!err.empty()) {
-                                                    device->GetControl(line->GetConfig()->Name)->SetError(tx, err);
-                                                } else {
-                                                    if (const auto& counter = line->GetCounter()) {
-                                                        for (const auto& idValue:
-                                                             counter->GetIdsAndValues(line->GetConfig()->Name)) {
-                                                            const auto& id = idValue.first;
-                                                            const auto value = idValue.second;
-
-                                                            device->GetControl(id)->SetRawValue(tx, value);
-                                                        }
-                                                    } else {
-                                                        device->GetControl(line->GetConfig()->Name)
-                                                            ->SetValue(tx, static_cast<bool>(line->GetValue()));
-                                                    }
-                                                }
-                                            });
-                                        }
-                                    }
-
-                                    LOG(Info) << "Stopped";
-                                }});
+    if (LockMemory) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+            LOG(Warn) << "Unable to lock memory: " << strerror(errno);
+        } else {
+            LOG(Info) << "Memory is locked";
+        }
+    }
+
+    if (PublishQueue) {
+        PublisherActive = true;
+        Publisher = WBMQTT::MakeThread("GPIO publisher", {[this] { RunPublisher(); }});
+    }
+
+    for (const auto& lane: Lanes) {
+        lane->Start();
+    }
 }
 
 void TGpioDriver::Stop()
@@ -309,12 +306,46 @@ void TGpioDriver::Stop()
     }
 
     LOG(Info) << "Stopping...";
+    for (const auto& lane: Lanes) {
+        lane->Stop();
+    }
+
+    if (Publisher) {
+        PublisherActive = false;
+        PublishQueue->Push(TControlUpdates()); // wake up publisher
+        if (Publisher->joinable()) {
+            Publisher->join();
+        }
+        Publisher.reset();
+    }
+}
 
-    if (Worker->joinable()) {
-        Worker->join();
+void TGpioDriver::EnqueueCommand(const PControl& control, const std::string& rawValue)
+{
+    TLineCommand command;
+    command.Control = control;
+    command.Line = control->GetUserData().As<PGpioLine>();
+
+    if (command.Line->IsOutput()) {
+        if (rawValue == "1") {
+            command.Value = 1;
+        } else if (rawValue == "0") {
+            command.Value = 0;
+        } else {
+            LOG(Warn) << "Invalid value: " << rawValue;
+            return;
+        }
+    } else {
+        char* end;
+        command.Value = strtof(rawValue.c_str(), &end);
+        if (end == rawValue.c_str()) {
+            LOG(Warn) << "Invalid value: " << rawValue;
+            return;
+        }
     }
 
-    Worker.reset();
+    command.EnqueueTime = chrono::steady_clock::now();
+    LineLanes.at(command.Line.get())->Enqueue(move(command));
 }
 
 void TGpioDriver::Clear() noexcept
@@ -330,7 +361,12 @@ void TGpioDriver::Clear() noexcept
 
     SuppressExceptions([this] { MqttDriver->BeginTx()->RemoveDeviceById(Name).Sync(); }, "TGpioDriver::Clear()");
 
-    SuppressExceptions([this] { ChipDrivers.clear(); }, "TGpioDriver::Clear()");
+    SuppressExceptions(
+        [this] {
+            LineLanes.clear();
+            Lanes.clear();
+        },
+        "TGpioDriver::Clear()");
 
     EventHandlerHandle = nullptr;
 
@@ -1,11 +1,14 @@
 #pragma once
 
 #include "declarations.h"
+#include "gpio_lane.h"
 
 #include <wblib/declarations.h>
 #include <wblib/promise.h>
 
+#include <atomic>
 #include <mutex>
+#include <unordered_map>
 #include <vector>
 
 class TGpioDriver
@@ -13,21 +16,39 @@ class TGpioDriver
     WBMQTT::PDeviceDriver MqttDriver;
     WBMQTT::PDriverEventHandlerHandle EventHandlerHandle;
 
-    std::vector<PGpioChipDriver> ChipDrivers;
-    std::unique_ptr<std::thread> Worker;
+    std::unique_ptr<TEdgeTraceWriter> TraceWriter; // shared by chip drivers, so it is destroyed after lanes
+    std::vector<PGpioLane> Lanes;
+    std::unordered_map<const TGpioLine*, TGpioLane*> LineLanes; // filled in constructor, read by MQTT thread
 
-    bool Active;
+    // changes of several lanes are merged into a single stream of MQTT transactions by publisher thread
+    std::unique_ptr<TPublishQueue> PublishQueue;
+    std::unique_ptr<std::thread> Publisher;
+    std::atomic_bool PublisherActive;
+
+    std::atomic_bool Active;
     std::mutex ActiveMutex;
 
+    size_t WorkerThreads;
+    bool LockMemory;
+
 public:
     static const char* const Name;
 
-    TGpioDriver(const WBMQTT::PDeviceDriver& mqttDriver, const TGpioDriverConfig& config);
+    TGpioDriver(const WBMQTT::PDeviceDriver& mqttDriver,
+                const TGpioDriverConfig& config,
+                const PGpioBackend& backend = GetKernelGpioBackend());
     ~TGpioDriver();
 
     void Start();
     void Stop();
     void Clear() noexcept;
+
+private:
+    TGpioLane* GetLane(const std::string& name, const TGpioDriverConfig& config);
+    std::string ShardLane(const std::string& name, size_t& shardedChips) const;
+    void RunPublisher();
+    void PublishQueuedChanges();
+    void EnqueueCommand(const WBMQTT::PControl& control, const std::string& rawValue);
 };
 
 WBMQTT::TFuture<WBMQTT::PControl> CreateOutputControl(WBMQTT::PLocalDevice device,
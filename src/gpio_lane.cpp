@@ -0,0 +1,323 @@
+#include "gpio_lane.h"
+#include "config.h"
+#include "exceptions.h"
+#include "gpio_counter.h"
+#include "gpio_driver.h"
+#include "gpio_line.h"
+#include "interruption_context.h"
+#include "log.h"
+
+#include <wblib/wbmqtt.h>
+
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define LOG(logger) ::logger.Log() << "[gpio lane] "
+
+using namespace std;
+using namespace WBMQTT;
+
+const char* const TGpioLane::MAIN = "main";
+const char* const TGpioLane::SLOW = "slow";
+
+const auto READBACK_INTERVAL = std::chrono::milliseconds(500);
+const auto EPOLL_EVENT_COUNT = 20;
+const auto LATENCY_REPORT_INTERVAL = std::chrono::minutes(10);
+
+// on-SoC GPIO is read in a few microseconds, expanders need a bus transfer of hundreds of them
+const auto SLOW_READ_LATENCY = std::chrono::microseconds(200);
+
+namespace
+{
+    void SetupWorkerThread(int priority, int cpu)
+    {
+        if (priority > 0) {
+            sched_param param{};
+            param.sched_priority = priority;
+            if (auto err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) {
+                LOG(Warn) << "Unable to set SCHED_FIFO priority " << priority << ": " << strerror(err);
+            } else {
+                LOG(Info) << "Running with SCHED_FIFO priority " << priority;
+            }
+        }
+
+        if (cpu >= 0) {
+            cpu_set_t cpuSet;
+            CPU_ZERO(&cpuSet);
+            CPU_SET(cpu, &cpuSet);
+            if (auto err = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet)) {
+                LOG(Warn) << "Unable to pin to CPU " << cpu << ": " << strerror(err);
+            } else {
+                LOG(Info) << "Pinned to CPU " << cpu;
+            }
+        }
+    }
+} // namespace
+
+TGpioLane::TGpioLane(const std::string& name, const WBMQTT::PDeviceDriver& mqttDriver, const TGpioDriverConfig& config)
+    : Name(name),
+      MqttDriver(mqttDriver),
+      Active(false),
+      PublishQueue(nullptr),
+      PublishUnchanged(config.PublishParameters.Policy != TPublishParameters::PublishOnlyOnChange),
+      Schedule(GetWorkerSchedule(name, config))
+{
+    WakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (WakeupFd < 0) {
+        wb_throw(TGpioDriverException, "unable to create eventfd: " + string(strerror(errno)));
+    }
+    WakeupSource = {WakeupFd, [this](const TInterruptionContext&) { return HandleWakeup(); }};
+}
+
+TGpioLane::~TGpioLane()
+{
+    Stop();
+    close(WakeupFd);
+}
+
+const std::string& TGpioLane::GetName() const
+{
+    return Name;
+}
+
+void TGpioLane::AddChipDriver(const PGpioChipDriver& chipDriver)
+{
+    ChipDrivers.push_back(chipDriver);
+}
+
+void TGpioLane::SetPublishQueue(TPublishQueue* publishQueue)
+{
+    PublishQueue = publishQueue;
+}
+
+std::string TGpioLane::SelectLane(const std::string& configured, const std::chrono::nanoseconds& readLatency)
+{
+    if (!configured.empty()) {
+        return configured;
+    }
+    return (readLatency >= SLOW_READ_LATENCY) ? SLOW : MAIN;
+}
+
+TWorkerSchedule TGpioLane::GetWorkerSchedule(const std::string& name, const TGpioDriverConfig& config)
+{
+    if (name == MAIN) {
+        return {config.WorkerPriority, config.WorkerCpu};
+    }
+    auto shardPrefix = string(MAIN) + "-";
+    if (name.size() > shardPrefix.size() && name.compare(0, shardPrefix.size(), shardPrefix) == 0 &&
+        all_of(name.begin() + shardPrefix.size(), name.end(), ::isdigit))
+    {
+        auto shard = stoi(name.substr(shardPrefix.size()));
+        return {config.WorkerPriority, (config.WorkerCpu >= 0) ? config.WorkerCpu + shard : -1};
+    }
+    return {0, -1};
+}
+
+void TGpioLane::Start()
+{
+    Active = true;
+    auto threadName = (Name == MAIN) ? string("GPIO worker") : "GPIO " + Name;
+    Worker = WBMQTT::MakeThread(threadName, {[this] { Run(); }});
+}
+
+void TGpioLane::Stop()
+{
+    if (!Worker) {
+        return;
+    }
+    Active = false;
+    Wakeup();
+
+    if (Worker->joinable()) {
+        Worker->join();
+    }
+    Worker.reset();
+}
+
+void TGpioLane::Run()
+{
+    LOG(Info) << "Started " << Name << " lane";
+    SetupWorkerThread(Schedule.Priority, Schedule.Cpu);
+    auto latencyReportTime = chrono::steady_clock::now() + LATENCY_REPORT_INTERVAL;
+    auto readbackTime = chrono::steady_clock::now() + READBACK_INTERVAL;
+
+    int epfd = epoll_create(1); // creating epoll for Interrupts
+    struct epoll_event events[EPOLL_EVENT_COUNT]{};
+
+    WB_SCOPE_EXIT(close(epfd);)
+
+    for (const auto& chipDriver: ChipDrivers) {
+        chipDriver->AddToEpoll(epfd);
+    }
+
+    struct epoll_event wakeupEvent{};
+    wakeupEvent.events = EPOLLIN;
+    wakeupEvent.data.ptr = &WakeupSource;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, WakeupFd, &wakeupEvent) < 0) {
+        LOG(Error) << "epoll_ctl error: '" << strerror(errno) << "' at wakeup eventfd";
+    }
+
+    while (Active) {
+        // sleep until a real event if no line needs readback. Inputs without
+        // interrupts are read by poll timers of chip drivers
+        bool needsReadback = any_of(ChipDrivers.begin(), ChipDrivers.end(), [](const PGpioChipDriver& chipDriver) {
+            return chipDriver->NeedsPolling();
+        });
+        int timeout = -1;
+        if (needsReadback) {
+            auto left = chrono::ceil<chrono::milliseconds>(readbackTime - chrono::steady_clock::now());
+            timeout = max<int>(0, left.count());
+        }
+
+        if (int count = epoll_wait(epfd, events, EPOLL_EVENT_COUNT, timeout)) {
+            TInterruptionContext ctx{count, events};
+            TGpioChipDriver::HandleInterrupt(ctx);
+        }
+
+        // readback deadline is checked after events too, so interrupts can't starve it
+        auto now = chrono::steady_clock::now();
+        if (needsReadback && now >= readbackTime) {
+            for (const auto& chipDriver: ChipDrivers) {
+                chipDriver->PollLines();
+            }
+            readbackTime = now + READBACK_INTERVAL;
+        } else if (!needsReadback) {
+            readbackTime = now + READBACK_INTERVAL;
+        }
+
+        PublishChanges();
+
+        if (chrono::steady_clock::now() >= latencyReportTime) {
+            ReportWakeupLatency();
+            latencyReportTime += LATENCY_REPORT_INTERVAL;
+        }
+    }
+
+    LOG(Info) << "Stopped " << Name << " lane";
+}
+
+void TGpioLane::PublishChanges()
+{
+    // capture fits into std::function's small buffer, so idle cycle does not allocate
+    auto collect = [this](const PGpioLine& line) { AppendControlUpdates(line, Updates); };
+
+    for (const auto& chipDriver: ChipDrivers) {
+        if (PublishUnchanged) {
+            /* unchanged values are throttled by MQTT driver according to max_unchanged_interval */
+            FOR_EACH_LINE(chipDriver, line)
+            {
+                collect(line);
+                line->ClearDirty();
+            });
+        } else {
+            chipDriver->ForEachDirtyLine(collect);
+        }
+    }
+
+    if (Updates.empty()) {
+        return;
+    }
+    if (PublishQueue) {
+        PublishQueue->Push(move(Updates));
+    } else {
+        PublishUpdates(MqttDriver->BeginTx(), Updates);
+    }
+    Updates.clear();
+}
+
+void TGpioLane::PublishUpdates(const PDriverTx& tx, const TControlUpdates& updates)
+{
+    auto device = tx->GetDevice(TGpioDriver::Name);
+    for (const auto& update: updates) {
+        auto control = device->GetControl(update.Id);
+        if (!control) {
+            LOG(Error) << "No control '" << update.Id << "' to publish";
+            continue;
+        }
+        if (!update.Error.empty()) {
+            control->SetError(tx, update.Error);
+        } else {
+            control->SetRawValue(tx, update.Value);
+        }
+    }
+}
+
+void TGpioLane::ReportWakeupLatency()
+{
+    TTimerQueue::TLatencyStats stats;
+    for (const auto& chipDriver: ChipDrivers) {
+        stats.Add(chipDriver->TakeWakeupLatencyStats());
+    }
+    if (stats.Count == 0) {
+        return;
+    }
+
+    auto toUs = [](const chrono::nanoseconds& ns) { return chrono::duration_cast<chrono::microseconds>(ns).count(); };
+    LOG(Info) << "Timer wakeup latency of " << Name << " lane: average " << toUs(stats.Total / stats.Count)
+              << "us, max " << toUs(stats.Max) << "us over " << stats.Count << " wakeups";
+}
+
+void TGpioLane::Wakeup()
+{
+    uint64_t one = 1;
+    if (write(WakeupFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        LOG(Error) << "Unable to wake up " << Name << " lane: " << strerror(errno);
+    }
+}
+
+void TGpioLane::Enqueue(TLineCommand&& command)
+{
+    Commands.Push(move(command));
+    Wakeup();
+}
+
+bool TGpioLane::HandleWakeup()
+{
+    uint64_t counter;
+    if (read(WakeupFd, &counter, sizeof(counter)) < 0 && errno != EAGAIN) {
+        LOG(Error) << "Read wakeup eventfd failed: " << strerror(errno);
+    }
+
+    bool isHandled = false;
+    TLineCommand command;
+    while (Commands.Pop(command)) {
+        ApplyCommand(command);
+        isHandled = true;
+    }
+    return isHandled;
+}
+
+void TGpioLane::ApplyCommand(TLineCommand& command)
+{
+    command.ApplyTime = chrono::steady_clock::now();
+
+    const auto& line = command.Line;
+    std::string valueForPublishing;
+    if (line->IsOutput()) {
+        line->SetValue(command.Value != 0);
+        valueForPublishing = (command.Value != 0) ? "1" : "0";
+    } else if (line->GetCounter()) {
+        line->GetCounter()->SetInitialValues(command.Value);
+        valueForPublishing = line->GetCounter()->GetRoundedTotal();
+    }
+
+    LOG(Debug) << "Command for " << line->DescribeShort() << " waited "
+               << chrono::duration_cast<chrono::microseconds>(command.ApplyTime - command.EnqueueTime).count()
+               << "us, applied in "
+               << chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - command.ApplyTime).count()
+               << "us";
+
+    auto control = command.Control;
+    if (!line->GetControlError().empty()) {
+        TControlUpdates updates;
+        AppendControlUpdates(line, updates);
+        MqttDriver->AccessAsync([=](const PDriverTx& tx) { PublishUpdates(tx, updates); });
+    } else {
+        MqttDriver->AccessAsync([=](const PDriverTx& tx) { control->SetRawValue(tx, valueForPublishing); });
+    }
+}
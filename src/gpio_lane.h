@@ -0,0 +1,96 @@
+#pragma once
+
+#include "declarations.h"
+#include "gpio_chip_driver.h"
+#include "mpsc_queue.h"
+#include "publish_queue.h"
+
+#include <wblib/declarations.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Line mutation requested by MQTT client. Queued by MQTT thread, applied by lane worker */
+struct TLineCommand
+{
+    WBMQTT::PControl Control;
+    PGpioLine Line;
+    float Value; // output state or counter total
+    TTimePoint EnqueueTime;
+    TTimePoint ApplyTime;
+};
+
+/* Scheduling of lane worker thread */
+struct TWorkerSchedule
+{
+    int Priority; // SCHED_FIFO priority, 0 - default scheduling
+    int Cpu;      // -1 - any CPU
+};
+
+/**
+ * @brief Worker thread with its own epoll, serving a group of chip drivers.
+ *        Chips behind slow buses (I2C/SPI expanders) are put to a separate lane,
+ *        so their blocking ioctls do not delay events of other chips.
+ *        All lanes publish to the same MQTT device: directly or through shared publish queue.
+ */
+class TGpioLane
+{
+    std::string Name;
+    WBMQTT::PDeviceDriver MqttDriver;
+    std::vector<PGpioChipDriver> ChipDrivers;
+    std::unique_ptr<std::thread> Worker;
+    std::atomic_bool Active;
+
+    int WakeupFd; // eventfd in worker's epoll, wakes it up from other threads
+    TEpollSource WakeupSource;
+    TMpscQueue<TLineCommand> Commands;
+
+    TPublishQueue* PublishQueue; // nullptr - publish by lane worker
+    TControlUpdates Updates;
+
+    bool PublishUnchanged;
+    TWorkerSchedule Schedule;
+
+public:
+    static const char* const MAIN;
+    static const char* const SLOW;
+
+    TGpioLane(const std::string& name, const WBMQTT::PDeviceDriver& mqttDriver, const TGpioDriverConfig& config);
+    ~TGpioLane();
+
+    TGpioLane(const TGpioLane&) = delete;
+    TGpioLane& operator=(const TGpioLane&) = delete;
+
+    const std::string& GetName() const;
+    void AddChipDriver(const PGpioChipDriver& chipDriver);
+
+    /* Makes lane pass its changes to queue instead of publishing them. Must be set before Start() */
+    void SetPublishQueue(TPublishQueue* publishQueue);
+
+    void Start();
+    void Stop();
+
+    /* Passes command to lane worker. Called from other threads */
+    void Enqueue(TLineCommand&& command);
+
+    /* Returns configured lane name. If it is empty, selects main or slow lane by latency of reading chip lines */
+    static std::string SelectLane(const std::string& configured, const std::chrono::nanoseconds& readLatency);
+
+    /* Main lane and its shards "main-N" run with worker_priority, shard N pinned to worker_cpu + N.
+       Slow and user-named lanes may block in bus transfers, so they run with default scheduling on any CPU */
+    static TWorkerSchedule GetWorkerSchedule(const std::string& name, const TGpioDriverConfig& config);
+
+    static void PublishUpdates(const WBMQTT::PDriverTx& tx, const TControlUpdates& updates);
+
+private:
+    void Run();
+    void PublishChanges();
+    void ReportWakeupLatency();
+    void Wakeup();
+    bool HandleWakeup();
+    void ApplyCommand(TLineCommand& command);
+};
+
+using PGpioLane = std::shared_ptr<TGpioLane>;
@@ -1,10 +1,13 @@
 #include "gpio_line.h"
+#include "config.h"
+#include "debounce_filter.h"
 #include "exceptions.h"
 #include "gpio_chip.h"
 #include "gpio_counter.h"
+#include "interrupt_storm_guard.h"
 #include "log.h"
+#include "timer_queue.h"
 
-#include <sys/ioctl.h>
 #include <wblib/utils.h>
 
 #include <cassert>
@@ -20,16 +23,24 @@ TGpioLine::TGpioLine(const PGpioChip& chip, const TGpioLineConfig& config)
     : Chip(chip),
       Offset(config.Offset),
       Fd(-1),
-      TimerFd(-1),
+      DebouncedByKernel(false),
+      CounterUpdatePending(false),
+      ErrorChanged(false),
+      ScheduledDebounceDeadline(TTimePoint::max()),
+      DebounceQueuePosition(TTimerQueue::NO_POSITION),
       Value(0),
       ValueUnfiltered(0),
       InterruptSupport(EInterruptSupport::UNKNOWN)
 {
     Config = WBMQTT::MakeUnique<TGpioLineConfig>(config);
+    DebounceFilter = MakeDebounceFilter(config);
 
     if (!config.Type.empty()) {
         Counter = WBMQTT::MakeUnique<TGpioCounter>(config);
     }
+    if (config.Direction == EGpioDirection::Input && config.MaxEdgeRate > 0) {
+        InterruptStormGuard = WBMQTT::MakeUnique<TInterruptStormGuard>(config.MaxEdgeRate);
+    }
 
     if (chip->IsValid())
         UpdateInfo();
@@ -41,7 +52,11 @@ TGpioLine::TGpioLine(const TGpioLineConfig& config)
     : Chip(PGpioChip()),
       Offset(config.Offset),
       Fd(-1),
-      TimerFd(-1),
+      DebouncedByKernel(false),
+      CounterUpdatePending(false),
+      ErrorChanged(false),
+      ScheduledDebounceDeadline(TTimePoint::max()),
+      DebounceQueuePosition(TTimerQueue::NO_POSITION),
       Value(0),
       ValueUnfiltered(0),
       InterruptSupport(EInterruptSupport::UNKNOWN)
@@ -50,16 +65,22 @@ TGpioLine::TGpioLine(const TGpioLineConfig& config)
     Flags = GPIOLINE_FLAG_IS_OUT;
     Consumer = "null";
     Config = WBMQTT::MakeUnique<TGpioLineConfig>(config);
+    DebounceFilter = MakeDebounceFilter(config);
 
     if (!config.Type.empty()) {
         Counter = WBMQTT::MakeUnique<TGpioCounter>(config);
     }
+    if (config.Direction == EGpioDirection::Input && config.MaxEdgeRate > 0) {
+        InterruptStormGuard = WBMQTT::MakeUnique<TInterruptStormGuard>(config.MaxEdgeRate);
+    }
 }
 
 TGpioLine::~TGpioLine()
 {
-    if (TimerFd > -1) {
-        close(TimerFd);
+    if (NeedsReadback()) {
+        if (auto chip = Chip.lock()) {
+            chip->UpdateReadbackLineCount(false);
+        }
     }
 }
 
@@ -69,7 +90,8 @@ void TGpioLine::UpdateInfo()
 
     info.line_offset = Offset;
 
-    int retVal = ioctl(AccessChip()->GetFd(), GPIO_GET_LINEINFO_IOCTL, &info);
+    auto chip = AccessChip();
+    int retVal = chip->GetBackend()->GetLineInfo(chip->GetFd(), info);
     if (retVal < 0) {
         LOG(Error) << "Unable to load " << Describe() << ": GPIO_GET_LINEINFO_IOCTL failed: " << strerror(errno);
         SetError("r");
@@ -203,7 +225,7 @@ void TGpioLine::SetValue(uint8_t value)
 
     data.values[0] = value;
 
-    if (ioctl(Fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) < 0) {
+    if (AccessChip()->GetBackend()->SetLineValues(Fd, data) < 0) {
         LOG(Error) << "Set " << to_string((int)value) << " to: " << DescribeShort()
                    << " GPIOHANDLE_SET_LINE_VALUES_IOCTL failed: " << strerror(errno);
         SetError("w");
@@ -232,6 +254,11 @@ PGpioChip TGpioLine::AccessChip() const
     return chip;
 }
 
+bool TGpioLine::HasChip() const
+{
+    return !Chip.expired();
+}
+
 bool TGpioLine::IsHandled() const
 {
     return Fd > -1;
@@ -239,19 +266,44 @@ bool TGpioLine::IsHandled() const
 
 void TGpioLine::SetFd(int fd)
 {
+    bool neededReadback = NeedsReadback();
     Fd = fd;
+    UpdateReadbackLineCount(neededReadback);
     UpdateInfo();
 }
 
 void TGpioLine::SetError(const std::string& err)
 {
-    if (Error.find(err) == std::string::npos)
+    if (Error.find(err) == std::string::npos) {
+        bool neededReadback = NeedsReadback();
         Error += err;
+        ErrorChanged = true;
+        UpdateReadbackLineCount(neededReadback);
+    }
 }
 
 void TGpioLine::ClearError()
 {
-    Error.clear();
+    if (!Error.empty()) {
+        bool neededReadback = NeedsReadback();
+        Error.clear();
+        ErrorChanged = true;
+        UpdateReadbackLineCount(neededReadback);
+    }
+}
+
+bool TGpioLine::IsDirty() const
+{
+    return Value.IsChanged() || ErrorChanged || (Counter && Counter->IsChanged());
+}
+
+void TGpioLine::ClearDirty()
+{
+    Value.ResetChanged();
+    ErrorChanged = false;
+    if (Counter) {
+        Counter->ResetChanged();
+    }
 }
 
 const std::string& TGpioLine::GetError() const
@@ -264,20 +316,50 @@ int TGpioLine::GetFd() const
     return Fd;
 }
 
-void TGpioLine::SetTimerFd(int fd)
+void TGpioLine::SetScheduledDebounceDeadline(const TTimePoint& deadline)
 {
-    if (TimerFd > -1) {
-        close(TimerFd);
-    }
+    ScheduledDebounceDeadline = deadline;
+}
+
+const TTimePoint& TGpioLine::GetScheduledDebounceDeadline() const
+{
+    return ScheduledDebounceDeadline;
+}
+
+size_t& TGpioLine::AccessDebounceQueuePosition()
+{
+    return DebounceQueuePosition;
+}
+
+bool TGpioLine::IsDebouncePending() const
+{
+    return ScheduledDebounceDeadline != TTimePoint::max();
+}
+
+TTimePoint TGpioLine::GetDebounceDeadline() const
+{
+    return DebounceFilter->GetSettleTime(*this);
+}
 
-    TimerFd = fd;
+void TGpioLine::SetDebouncedByKernel(bool debouncedByKernel)
+{
+    DebouncedByKernel = debouncedByKernel;
 }
 
-int TGpioLine::GetTimerFd() const
+bool TGpioLine::IsDebouncedByKernel() const
 {
-    assert(TimerFd > -1);
+    return DebouncedByKernel;
+}
 
-    return TimerFd;
+std::chrono::microseconds TGpioLine::GetDebounceTimeout() const
+{
+    return DebouncedByKernel ? std::chrono::microseconds::zero()
+                             : ::GetDebounceTimeout(*GetConfig(), GetValueUnfiltered());
+}
+
+bool TGpioLine::IsCommittedOnEdge() const
+{
+    return GetDebounceDeadline() <= PreviousInterruptionTimePoint;
 }
 
 const TTimePoint& TGpioLine::GetInterruptionTimepoint() const
@@ -300,11 +382,86 @@ void TGpioLine::HandleInterrupt(const TTimePoint& interruptTimePoint)
     PreviousInterruptionTimePoint = interruptTimePoint;
 }
 
-void TGpioLine::Update()
+void TGpioLine::HandleEdge(uint8_t value, const TTimePoint& time)
+{
+    DebounceFilter->HandleEdge(*this, value, time);
+    SetCachedValueUnfiltered(value);
+    HandleInterrupt(time);
+}
+
+bool TGpioLine::HandleSample(uint8_t value, const TTimePoint& time)
+{
+    /* Polled lines have no events: a level differing from the previous sample is an edge at the sample time.
+       The level is committed by the first sample taken at or after its debounce deadline, samples in between
+       seeing another level restart the debounce as edges do */
+    if (value != GetValueUnfiltered()) {
+        HandleEdge(value, time);
+        ScheduledDebounceDeadline = GetDebounceDeadline();
+    }
+    if (ScheduledDebounceDeadline > time) {
+        return false;
+    }
+    ScheduledDebounceDeadline = TTimePoint::max();
+    return UpdateIfStable(time);
+}
+
+void TGpioLine::Update(const TTimePoint& now)
 {
     if (Counter) {
-        Counter->Update(
-            chrono::duration_cast<chrono::microseconds>(std::chrono::steady_clock::now() - GetInterruptionTimepoint()));
+        Counter->Update(GetIntervalFromPreviousInterrupt(now));
+    }
+}
+
+void TGpioLine::SetCounterUpdatePending(bool pending)
+{
+    CounterUpdatePending = pending;
+}
+
+bool TGpioLine::IsCounterUpdatePending() const
+{
+    return CounterUpdatePending;
+}
+
+TTimePoint TGpioLine::GetCounterUpdateDeadline(const TTimePoint& now) const
+{
+    if (!Counter) {
+        return TTimePoint::max();
+    }
+    auto interval = Counter->GetNextUpdateInterval(GetIntervalFromPreviousInterrupt(now));
+    if (interval == TTimeIntervalUs::max()) {
+        return TTimePoint::max();
+    }
+    return GetInterruptionTimepoint() + interval;
+}
+
+bool TGpioLine::NeedsPolling() const
+{
+    if (!GetError().empty()) {
+        return true; // to detect recovery
+    }
+    if (GetConfig()->Direction == EGpioDirection::Input && InterruptSupport != EInterruptSupport::YES) {
+        return true; // to read values
+    }
+    return GetConfig()->Readback;
+}
+
+bool TGpioLine::NeedsReadback() const
+{
+    // inputs without interrupts are read by poll timer, lines that are not requested are not read at all
+    if (Fd < 0 || (Config->Direction == EGpioDirection::Input && InterruptSupport != EInterruptSupport::YES)) {
+        return false;
+    }
+    return !Error.empty() || Config->Readback;
+}
+
+void TGpioLine::UpdateReadbackLineCount(bool neededReadback)
+{
+    bool needsReadback = NeedsReadback();
+    if (needsReadback == neededReadback) {
+        return;
+    }
+    if (auto chip = Chip.lock()) {
+        chip->UpdateReadbackLineCount(needsReadback);
     }
 }
 
@@ -313,6 +470,39 @@ const PUGpioCounter& TGpioLine::GetCounter() const
     return Counter;
 }
 
+bool TGpioLine::CountEdge(const TTimePoint& time)
+{
+    return InterruptStormGuard && InterruptStormGuard->HandleEdge(time);
+}
+
+TTimePoint TGpioLine::StartInterruptStorm(const TTimePoint& now)
+{
+    ErrorChanged = true;
+    return InterruptStormGuard->StartStorm(now);
+}
+
+void TGpioLine::EndInterruptStorm(const TTimePoint& now)
+{
+    ErrorChanged = true;
+    InterruptStormGuard->EndStorm(now);
+}
+
+bool TGpioLine::IsInterruptStorm() const
+{
+    return InterruptStormGuard && InterruptStormGuard->IsStorm();
+}
+
+const PUInterruptStormGuard& TGpioLine::GetInterruptStormGuard() const
+{
+    return InterruptStormGuard;
+}
+
+std::string TGpioLine::GetControlError() const
+{
+    // level of a line in edge storm is unreliable: it is floating or broken
+    return (Error.empty() && IsInterruptStorm()) ? "r" : Error;
+}
+
 const PUGpioLineConfig& TGpioLine::GetConfig() const
 {
     assert(Config);
@@ -322,7 +512,9 @@ const PUGpioLineConfig& TGpioLine::GetConfig() const
 
 void TGpioLine::SetInterruptSupport(EInterruptSupport interruptSupport)
 {
+    bool neededReadback = NeedsReadback();
     InterruptSupport = interruptSupport;
+    UpdateReadbackLineCount(neededReadback);
 }
 
 EInterruptSupport TGpioLine::GetInterruptSupport() const
@@ -332,17 +524,19 @@ EInterruptSupport TGpioLine::GetInterruptSupport() const
 
 bool TGpioLine::UpdateIfStable(const TTimePoint& checkTimePoint)
 {
-    auto fromLastTs = GetIntervalFromPreviousInterrupt(checkTimePoint);
-    if (fromLastTs <= GetConfig()->DebounceTimeout) {
+    if (GetDebounceDeadline() > checkTimePoint) {
         return false;
     }
 
-    // The line has held a steady level for the whole debounce window, so the
-    // settled level is real (not bounce/noise). Commit it as the filtered value.
+    // The debounce filter considers the level settled, so it is real
+    // (not bounce/noise). Commit it as the filtered value.
+    auto changeTimePoint = DebounceFilter->GetChangeTime(*this, checkTimePoint);
     bool previousStable = GetValue();
     bool newStable = GetValueUnfiltered();
     SetCachedValue(newStable);
-    LOG(Debug) << "Value (" << newStable << ") on (" << GetName() << " is stable for " << fromLastTs.count() << "us";
+    DebounceFilter->HandleCommit(*this);
+    LOG(Debug) << "Value (" << newStable << ") on (" << GetName() << " is stable for "
+               << GetIntervalFromPreviousInterrupt(checkTimePoint).count() << "us";
 
     const auto& gpioCounter = GetCounter();
     if (gpioCounter) {
@@ -363,9 +557,9 @@ bool TGpioLine::UpdateIfStable(const TTimePoint& checkTimePoint)
 
         if (counted) {
             auto fromLastStableValTs =
-                chrono::duration_cast<chrono::microseconds>(checkTimePoint - PreviousStableValAcquiredTimePoint);
+                chrono::duration_cast<chrono::microseconds>(changeTimePoint - PreviousStableValAcquiredTimePoint);
             gpioCounter->HandleInterrupt(GetInterruptEdge(), fromLastStableValTs);
-            PreviousStableValAcquiredTimePoint = checkTimePoint;
+            PreviousStableValAcquiredTimePoint = changeTimePoint;
         }
     }
     return true;
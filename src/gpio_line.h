@@ -9,18 +9,25 @@ class TGpioLine
 {
     PWGpioChip Chip;
     PUGpioCounter Counter;
+    PUDebounceFilter DebounceFilter;
+    PUInterruptStormGuard InterruptStormGuard; // nullptr - edge rate is not limited
     PUGpioLineConfig Config;
 
     uint32_t Offset;
     uint32_t Flags;
     int Fd;
-    int TimerFd;
+    bool DebouncedByKernel;
+    bool CounterUpdatePending;
     std::string Error;
+    bool ErrorChanged;
     std::string Name;
     std::string Consumer;
 
     TTimePoint PreviousInterruptionTimePoint;
     TTimePoint PreviousStableValAcquiredTimePoint;
+    TTimePoint ScheduledDebounceDeadline; // earliest debounce deadline in timer queue or, for polled lines,
+                                          // the one next samples check, max() - none
+    size_t DebounceQueuePosition;         // of the deadline in heap of timer queue, kept by the queue
 
     TValue<uint8_t> Value;
     TValue<uint8_t> ValueUnfiltered;
@@ -29,7 +36,7 @@ class TGpioLine
 
 public:
     TGpioLine(const PGpioChip& chip, const TGpioLineConfig& config);
-    TGpioLine(const TGpioLineConfig& config); // dummy gpioline for tests
+    TGpioLine(const TGpioLineConfig& config); // line without chip: for tests and benchmarks
     ~TGpioLine();
 
     void UpdateInfo();
@@ -53,20 +60,46 @@ public:
     const std::string& GetError() const;
     void SetError(const std::string&);
     void ClearError();
+    bool IsDirty() const;
+    void ClearDirty();
     PGpioChip AccessChip() const;
+    bool HasChip() const;
     virtual bool IsHandled() const;
     void SetFd(int);
     int GetFd() const;
-    void SetTimerFd(int);
-    int GetTimerFd() const;
+    void SetScheduledDebounceDeadline(const TTimePoint&);
+    const TTimePoint& GetScheduledDebounceDeadline() const;
+    size_t& AccessDebounceQueuePosition(); // position slot of debounce timer queue
+    bool IsDebouncePending() const;
+    TTimePoint GetDebounceDeadline() const;
+    void SetDebouncedByKernel(bool);
+    bool IsDebouncedByKernel() const;
+    std::chrono::microseconds GetDebounceTimeout() const; // window of unfiltered level
+    bool IsCommittedOnEdge() const; // debounced by kernel or window of unfiltered level is 0
     EGpioEdge GetInterruptEdge() const;
     void HandleInterrupt(const TTimePoint&);
-    void Update();
+    void HandleEdge(uint8_t value, const TTimePoint& time); // new unfiltered level from kernel event
+    bool HandleSample(uint8_t value, const TTimePoint& time); // level read by polling, true if a level is committed
+    void Update(const TTimePoint& now);
+    void SetCounterUpdatePending(bool);
+    bool IsCounterUpdatePending() const;
+    TTimePoint GetCounterUpdateDeadline(const TTimePoint& now) const; // TTimePoint::max() if counter needs no update
+    bool NeedsPolling() const;
+    bool NeedsReadback() const; // requested and read back by lane worker, not by poll timer
     const PUGpioCounter& GetCounter() const;
+    bool CountEdge(const TTimePoint& time); // true if edge rate of interrupt input exceeds its limit
+    TTimePoint StartInterruptStorm(const TTimePoint& now); // returns time to enable interrupts back
+    void EndInterruptStorm(const TTimePoint& now);
+    bool IsInterruptStorm() const; // interrupts are disabled by edge storm, the line is polled
+    const PUInterruptStormGuard& GetInterruptStormGuard() const;
+    std::string GetControlError() const; // error published for controls of the line
     const PUGpioLineConfig& GetConfig() const;
     void SetInterruptSupport(EInterruptSupport interruptSupport);
     EInterruptSupport GetInterruptSupport() const;
     std::chrono::microseconds GetIntervalFromPreviousInterrupt(const TTimePoint& interruptTimePoint) const;
     bool UpdateIfStable(const TTimePoint& checkTimePoint);
     const TTimePoint& GetInterruptionTimepoint() const;
+
+private:
+    void UpdateReadbackLineCount(bool neededReadback); // counts the line by its chip if readback need is changed
 };
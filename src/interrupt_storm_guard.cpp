@@ -0,0 +1,56 @@
+#include "interrupt_storm_guard.h"
+
+#include <algorithm>
+
+using namespace std;
+
+TInterruptStormGuard::TInterruptStormGuard(uint32_t maxEdgeRate)
+    : MaxEdges(max<uint64_t>(1, static_cast<uint64_t>(maxEdgeRate) * STORM_WINDOW.count() / 1000)),
+      EdgeCount(0),
+      WindowStart(TTimePoint::min()),
+      QuietPeriod(STORM_MIN_QUIET_PERIOD),
+      ReenableTime(TTimePoint::max()),
+      LastStormEnd(TTimePoint::min())
+{}
+
+bool TInterruptStormGuard::HandleEdge(const TTimePoint& time)
+{
+    if (WindowStart == TTimePoint::min() || time - WindowStart >= STORM_WINDOW) {
+        WindowStart = time;
+        EdgeCount = 0;
+    }
+    return ++EdgeCount > MaxEdges;
+}
+
+TTimePoint TInterruptStormGuard::StartStorm(const TTimePoint& now)
+{
+    if (LastStormEnd != TTimePoint::min() && now - LastStormEnd < QuietPeriod) {
+        QuietPeriod = min<chrono::milliseconds>(QuietPeriod * 2, STORM_MAX_QUIET_PERIOD);
+    } else {
+        QuietPeriod = STORM_MIN_QUIET_PERIOD;
+    }
+    ReenableTime = now + QuietPeriod;
+    return ReenableTime;
+}
+
+void TInterruptStormGuard::EndStorm(const TTimePoint& now)
+{
+    ReenableTime = TTimePoint::max();
+    LastStormEnd = now;
+    WindowStart = TTimePoint::min();
+}
+
+bool TInterruptStormGuard::IsStorm() const
+{
+    return ReenableTime != TTimePoint::max();
+}
+
+const TTimePoint& TInterruptStormGuard::GetReenableTime() const
+{
+    return ReenableTime;
+}
+
+const chrono::milliseconds& TInterruptStormGuard::GetQuietPeriod() const
+{
+    return QuietPeriod;
+}
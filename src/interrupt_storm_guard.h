@@ -0,0 +1,41 @@
+#pragma once
+
+#include "declarations.h"
+
+#include <chrono>
+
+const auto STORM_WINDOW = std::chrono::milliseconds(100);
+const auto STORM_MIN_QUIET_PERIOD = std::chrono::seconds(10);
+const auto STORM_MAX_QUIET_PERIOD = std::chrono::minutes(10);
+
+/**
+ * @brief Edge rate accounting of an interrupt input. Edges are counted in windows of STORM_WINDOW,
+ *        a window with more edges than max rate allows starts a storm: interrupts of the line are disabled
+ *        and it is polled. Interrupts are enabled back after a quiet period, which doubles for a storm
+ *        started within the quiet period of the previous one and is reset otherwise.
+ */
+class TInterruptStormGuard
+{
+    uint32_t MaxEdges; // per window
+    uint32_t EdgeCount;
+    TTimePoint WindowStart;
+    std::chrono::milliseconds QuietPeriod; // of the last storm
+    TTimePoint ReenableTime;               // of the current storm, TTimePoint::max() - interrupts are enabled
+    TTimePoint LastStormEnd;               // TTimePoint::min() - no storms yet
+
+public:
+    explicit TInterruptStormGuard(uint32_t maxEdgeRate);
+
+    /* Counts edge, returns true if the line exceeds max edge rate */
+    bool HandleEdge(const TTimePoint& time);
+
+    /* Interrupts are disabled, returns time to enable them back */
+    TTimePoint StartStorm(const TTimePoint& now);
+
+    /* Interrupts are enabled back */
+    void EndStorm(const TTimePoint& now);
+
+    bool IsStorm() const;
+    const TTimePoint& GetReenableTime() const;
+    const std::chrono::milliseconds& GetQuietPeriod() const;
+};
@@ -1,21 +1,16 @@
 #pragma once
 
-#include <chrono>
-#include <linux/types.h>
-
+/* Events of one epoll wakeup, dispatched to their handlers */
 struct TInterruptionContext
 {
-    static bool InterruptTimestampClockIsMonotonic;
+    static bool InterruptTimestampClockIsMonotonic; // false - uAPI v1 events are timestamped by CLOCK_REALTIME
 
     const int Count;
     const struct epoll_event* Events;
-    std::chrono::nanoseconds Diff;
 
     TInterruptionContext(int count, struct epoll_event* events);
     TInterruptionContext(const TInterruptionContext&) = delete;
     TInterruptionContext(TInterruptionContext&&) = delete;
 
-    std::chrono::steady_clock::time_point ToSteadyClock(__u64 timestamp) const;
-
     static void SetMonotonicClockForInterruptTimestamp();
 };
@@ -2,6 +2,7 @@
 #include "gpio_driver.h"
 #include "interruption_context.h"
 #include "log.h"
+#include "trace_replay.h"
 #include "utils.h"
 
 #include <wblib/json_utils.h>
@@ -58,6 +59,8 @@ namespace
              << "  -u user      MQTT user (optional)" << endl
              << "  -P password  MQTT user password (optional)" << endl
              << "  -T prefix    MQTT topic prefix (optional)" << endl
+             << "  -r file      record edges and poll samples of lines to trace file" << endl
+             << "  -R file      replay trace file through lines of config and print published values" << endl
              << "  -j           Make JSON for wb-mqtt-confed from "
                 "/etc/wb-mqtt-gpio.conf"
              << endl
@@ -68,12 +71,14 @@ namespace
                           char* argv[],
                           WBMQTT::TMosquittoMqttConfig& mqttConfig,
                           string& customConfig,
+                          string& traceFile,
+                          string& replayFile,
                           DebugLevel& debugLevel)
     {
         int c;
         debugLevel = DebugLevel::NONE;
 
-        while ((c = getopt(argc, argv, "d:c:h:p:u:P:T:jJ")) != -1) {
+        while ((c = getopt(argc, argv, "d:c:h:p:u:P:T:r:R:jJ")) != -1) {
             switch (c) {
                 case 'd':
                     debugLevel = static_cast<DebugLevel>(stoi(optarg));
@@ -96,6 +101,12 @@ namespace
                 case 'P':
                     mqttConfig.Password = optarg;
                     break;
+                case 'r':
+                    traceFile = optarg;
+                    break;
+                case 'R':
+                    replayFile = optarg;
+                    break;
                 case 'j':
                     try {
                         MakeJsonForConfed(CONFIG_FILE, SYSTEM_CONFIGS_DIR, CONFIG_SCHEMA_FILE);
@@ -174,6 +185,33 @@ namespace
         return (kernel.Patchlevel < 3);
     }
 
+    /* Prints "<time ns> <control> <value>" for every value published during replay */
+    int ReplayTrace(const string& configFileName, const string& replayFile)
+    {
+        try {
+            TTraceReplay replay(LoadConfig(CONFIG_FILE, configFileName, SYSTEM_CONFIGS_DIR, CONFIG_SCHEMA_FILE));
+            auto start = chrono::steady_clock::now();
+            auto count = replay.Run(replayFile, [](const TTimePoint& time, const TControlUpdates& updates) {
+                auto ns = chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch()).count();
+                for (const auto& update: updates) {
+                    if (update.Error.empty()) {
+                        cout << ns << " " << update.Id << " " << update.Value << "\n";
+                    } else {
+                        cout << ns << " " << update.Id << "/meta/error " << update.Error << "\n";
+                    }
+                }
+            });
+            cout.flush();
+            LOG(Info) << "Replayed " << count << " records in "
+                      << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count()
+                      << "ms";
+        } catch (const std::exception& e) {
+            LOG(Error) << "FATAL: " << e.what();
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
     void SetDebugLevel(DebugLevel level)
     {
         switch (level) {
@@ -220,7 +258,16 @@ int main(int argc, char* argv[])
     DebugLevel debugLevel = DebugLevel::NONE;
 
     string configFileName;
-    ParseCommandLine(argc, argv, mqttConfig, configFileName, debugLevel);
+    string traceFile;
+    string replayFile;
+    ParseCommandLine(argc, argv, mqttConfig, configFileName, traceFile, replayFile, debugLevel);
+
+    if (!replayFile.empty()) {
+        if (debugLevel != DebugLevel::NONE) {
+            SetDebugLevel(debugLevel);
+        }
+        return ReplayTrace(configFileName, replayFile);
+    }
 
     WBMQTT::TPromise<void> initialized;
 
@@ -270,6 +317,8 @@ int main(int argc, char* argv[])
         SetDebugLevel(DebugLevel::DEBUG_GPIO);
     }
 
+    config.TraceFile = traceFile;
+
     try {
         auto mqttDriver =
             WBMQTT::NewDriver(WBMQTT::TDriverArgs{}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+/**
+ * @brief Unbounded lock-free multi-producer single-consumer FIFO queue.
+ *        Push() may be called from any thread, Pop() only from the consumer thread.
+ *        Element pushed by one thread is visible to Pop() once its Push() has returned.
+ */
+template<typename T> class TMpscQueue
+{
+    struct TNode
+    {
+        std::atomic<TNode*> Next{nullptr};
+        T Value;
+    };
+
+    std::atomic<TNode*> Head; // last pushed node, producers side
+    TNode* Tail;              // already consumed node, its Next is the queue front
+
+public:
+    TMpscQueue(): Head(new TNode), Tail(Head.load())
+    {}
+
+    ~TMpscQueue()
+    {
+        T value;
+        while (Pop(value)) {
+        }
+        delete Tail;
+    }
+
+    TMpscQueue(const TMpscQueue&) = delete;
+    TMpscQueue& operator=(const TMpscQueue&) = delete;
+
+    void Push(T value)
+    {
+        auto node = new TNode;
+        node->Value = std::move(value);
+        auto prev = Head.exchange(node, std::memory_order_acq_rel);
+        prev->Next.store(node, std::memory_order_release);
+    }
+
+    bool Pop(T& value)
+    {
+        auto next = Tail->Next.load(std::memory_order_acquire);
+        if (!next) {
+            return false;
+        }
+        value = std::move(next->Value);
+        delete Tail;
+        Tail = next;
+        return true;
+    }
+};
@@ -0,0 +1,75 @@
+#include "publish_queue.h"
+#include "config.h"
+#include "exceptions.h"
+#include "gpio_counter.h"
+#include "gpio_line.h"
+#include "log.h"
+
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define LOG(logger) ::logger.Log() << "[publish queue] "
+
+using namespace std;
+
+void AppendControlUpdates(const PGpioLine& line, TControlUpdates& updates)
+{
+    const auto& name = line->GetConfig()->Name;
+
+    auto error = line->GetControlError();
+    const auto& counter = line->GetCounter();
+    if (!error.empty()) {
+        // counter line has no control of its own name, the error is set to all its controls
+        if (counter) {
+            for (auto& idValue: counter->GetIdsAndValues(name)) {
+                updates.push_back({move(idValue.first), string(), error});
+            }
+        } else {
+            updates.push_back({name, string(), move(error)});
+        }
+    } else if (counter) {
+        for (auto& idValue: counter->GetIdsAndValues(name)) {
+            updates.push_back({move(idValue.first), move(idValue.second), string()});
+        }
+    } else {
+        updates.push_back({name, line->GetValue() ? "1" : "0", string()});
+    }
+}
+
+TPublishQueue::TPublishQueue()
+{
+    Fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (Fd < 0) {
+        wb_throw(TGpioDriverException, "unable to create eventfd: " + string(strerror(errno)));
+    }
+}
+
+TPublishQueue::~TPublishQueue()
+{
+    close(Fd);
+}
+
+int TPublishQueue::GetFd() const
+{
+    return Fd;
+}
+
+void TPublishQueue::Push(TControlUpdates&& batch)
+{
+    Batches.Push(move(batch));
+
+    uint64_t one = 1;
+    if (write(Fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        LOG(Error) << "Unable to signal publish queue: " << strerror(errno);
+    }
+}
+
+void TPublishQueue::Acknowledge()
+{
+    // batches pushed after this read signal the eventfd again, so none of them is left unnoticed
+    uint64_t counter;
+    if (read(Fd, &counter, sizeof(counter)) < 0 && errno != EAGAIN) {
+        LOG(Error) << "Read publish queue eventfd failed: " << strerror(errno);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "declarations.h"
+#include "mpsc_queue.h"
+
+#include <string>
+#include <vector>
+
+/* New value or error of MQTT control, produced by lane worker */
+struct TControlUpdate
+{
+    std::string Id;
+    std::string Value;
+    std::string Error; // published instead of value if not empty
+};
+
+using TControlUpdates = std::vector<TControlUpdate>;
+
+/* Appends updates of all controls of line: value, counter values or error */
+void AppendControlUpdates(const PGpioLine& line, TControlUpdates& updates);
+
+/**
+ * @brief Merges control updates of several lane workers into a single stream.
+ *        Workers push batches without locks, consumer takes them in push order.
+ *        Eventfd of the queue is readable while it may have batches, so consumer can wait for it by poll/epoll.
+ */
+class TPublishQueue
+{
+    TMpscQueue<TControlUpdates> Batches;
+    int Fd;
+
+public:
+    TPublishQueue();
+    ~TPublishQueue();
+
+    TPublishQueue(const TPublishQueue&) = delete;
+    TPublishQueue& operator=(const TPublishQueue&) = delete;
+
+    int GetFd() const;
+
+    /* Called by workers */
+    void Push(TControlUpdates&& batch);
+
+    /* Called by consumer: passes every batch pushed so far to handler, returns number of batches */
+    template<typename THandler> size_t Drain(THandler&& handler)
+    {
+        Acknowledge();
+
+        size_t count = 0;
+        TControlUpdates batch;
+        while (Batches.Pop(batch)) {
+            handler(batch);
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    void Acknowledge();
+};
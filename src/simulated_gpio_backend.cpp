@@ -0,0 +1,622 @@
+#include "simulated_gpio_backend.h"
+#include "clock.h"
+#include "exceptions.h"
+#include "interruption_context.h"
+
+#include <wblib/utils.h>
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+    const auto GENERATOR_STOP_CHECK_INTERVAL = chrono::milliseconds(10);
+
+    int Fail(int error)
+    {
+        errno = error;
+        return -1;
+    }
+
+    uint64_t GetV2FlagsFromHandleFlags(uint32_t handleFlags)
+    {
+        uint64_t flags = 0;
+        if (handleFlags & GPIOHANDLE_REQUEST_INPUT)
+            flags |= GPIO_V2_LINE_FLAG_INPUT;
+        if (handleFlags & GPIOHANDLE_REQUEST_OUTPUT)
+            flags |= GPIO_V2_LINE_FLAG_OUTPUT;
+        if (handleFlags & GPIOHANDLE_REQUEST_ACTIVE_LOW)
+            flags |= GPIO_V2_LINE_FLAG_ACTIVE_LOW;
+        if (handleFlags & GPIOHANDLE_REQUEST_OPEN_DRAIN)
+            flags |= GPIO_V2_LINE_FLAG_OPEN_DRAIN;
+        if (handleFlags & GPIOHANDLE_REQUEST_OPEN_SOURCE)
+            flags |= GPIO_V2_LINE_FLAG_OPEN_SOURCE;
+        return flags;
+    }
+
+    uint32_t GetHandleFlagsFromV2Flags(uint64_t flags)
+    {
+        uint32_t lineFlags = GPIOLINE_FLAG_KERNEL;
+        if (flags & GPIO_V2_LINE_FLAG_OUTPUT)
+            lineFlags |= GPIOLINE_FLAG_IS_OUT;
+        if (flags & GPIO_V2_LINE_FLAG_ACTIVE_LOW)
+            lineFlags |= GPIOLINE_FLAG_ACTIVE_LOW;
+        if (flags & GPIO_V2_LINE_FLAG_OPEN_DRAIN)
+            lineFlags |= GPIOLINE_FLAG_OPEN_DRAIN;
+        if (flags & GPIO_V2_LINE_FLAG_OPEN_SOURCE)
+            lineFlags |= GPIOLINE_FLAG_OPEN_SOURCE;
+        return lineFlags;
+    }
+
+    bool GetLogicalValue(uint64_t flags, bool level)
+    {
+        return level != ((flags & GPIO_V2_LINE_FLAG_ACTIVE_LOW) != 0);
+    }
+
+    void SimulateBusTransfer(const chrono::nanoseconds& latency)
+    {
+        if (latency > chrono::nanoseconds::zero()) {
+            this_thread::sleep_for(latency);
+        }
+    }
+
+    template<size_t N> void CopyString(char (&to)[N], const string& from)
+    {
+        strncpy(to, from.c_str(), N - 1);
+        to[N - 1] = '\0';
+    }
+} // namespace
+
+TSimulatedGpioBackend::TSimulatedGpioBackend(const PClock& clock): Clock(clock), DroppedEvents(0)
+{}
+
+TSimulatedGpioBackend::~TSimulatedGpioBackend()
+{
+    for (const auto& fdRequest: Requests) {
+        if (fdRequest.second.WriteFd >= 0) {
+            close(fdRequest.second.WriteFd);
+        }
+        close(fdRequest.first);
+    }
+    for (const auto& fdChip: ChipFds) {
+        close(fdChip.first);
+    }
+}
+
+void TSimulatedGpioBackend::AddChip(const TSimulatedGpioChipConfig& config)
+{
+    lock_guard<mutex> lock(Mutex);
+    if (Chips.count(config.Path)) {
+        wb_throw(TGpioDriverException, "simulated chip '" + config.Path + "' already exists");
+    }
+    auto& chip = Chips[config.Path];
+    chip.Config = config;
+    chip.Lines.resize(config.LineCount);
+}
+
+void TSimulatedGpioBackend::SetLevel(const string& path, uint32_t offset, bool level)
+{
+    lock_guard<mutex> lock(Mutex);
+    auto& chip = Chips.at(path);
+    ChangeLevel(chip, offset, level, Clock->Now(), true);
+}
+
+void TSimulatedGpioBackend::Toggle(const string& path, uint32_t offset, const TBounceProfile& bounce)
+{
+    lock_guard<mutex> lock(Mutex);
+    auto& chip = Chips.at(path);
+    auto& line = chip.Lines.at(offset);
+
+    // every bounce pulse is a pair of transitions, the last transition settles the line at the opposite level
+    auto transitions = bounce.Count * 2 + 1;
+    bool isBounceFiltered = (chrono::microseconds(line.DebouncePeriodUs) > bounce.Interval);
+    auto now = Clock->Now();
+    auto level = line.Level;
+    for (uint32_t i = 0; i < transitions; ++i) {
+        level = !level;
+        bool isLast = (i + 1 == transitions);
+        ChangeLevel(chip, offset, level, now - bounce.Interval * (transitions - 1 - i), isLast || !isBounceFiltered);
+    }
+}
+
+bool TSimulatedGpioBackend::GetLevel(const string& path, uint32_t offset) const
+{
+    lock_guard<mutex> lock(Mutex);
+    return Chips.at(path).Lines.at(offset).Level;
+}
+
+void TSimulatedGpioBackend::InjectEdge(const string& path, uint32_t offset, bool value)
+{
+    lock_guard<mutex> lock(Mutex);
+    auto& line = Chips.at(path).Lines.at(offset);
+    line.Level = GetLogicalValue(line.Flags, value);
+
+    auto request = FindRequest(line.RequestFd);
+    if (request && request->WriteFd >= 0 &&
+        (line.Flags & (value ? GPIO_V2_LINE_FLAG_EDGE_RISING : GPIO_V2_LINE_FLAG_EDGE_FALLING)))
+    {
+        WriteEvent(*request, line, offset, value, Clock->Now());
+    }
+}
+
+void TSimulatedGpioBackend::SetValue(const string& path, uint32_t offset, bool value)
+{
+    lock_guard<mutex> lock(Mutex);
+    auto& line = Chips.at(path).Lines.at(offset);
+    line.Level = GetLogicalValue(line.Flags, value);
+}
+
+uint64_t TSimulatedGpioBackend::GetDroppedEventCount() const
+{
+    return DroppedEvents;
+}
+
+void TSimulatedGpioBackend::ChangeLevel(TChip& chip,
+                                        uint32_t offset,
+                                        bool level,
+                                        const TTimePoint& time,
+                                        bool isSettled)
+{
+    auto& line = chip.Lines.at(offset);
+    if (line.Level == level) {
+        return;
+    }
+    line.Level = level;
+
+    auto request = FindRequest(line.RequestFd);
+    if (!request || request->WriteFd < 0) {
+        return;
+    }
+    if (line.DebouncePeriodUs > 0 && !isSettled) {
+        return;
+    }
+
+    bool isRising = GetLogicalValue(line.Flags, level);
+    if (line.Flags & (isRising ? GPIO_V2_LINE_FLAG_EDGE_RISING : GPIO_V2_LINE_FLAG_EDGE_FALLING)) {
+        WriteEvent(*request, line, offset, isRising, time);
+    }
+}
+
+void TSimulatedGpioBackend::WriteEvent(TRequest& request,
+                                       TLine& line,
+                                       uint32_t offset,
+                                       bool isRising,
+                                       const TTimePoint& time)
+{
+    ssize_t size;
+    if (request.Type == ERequestType::EVENT_V1) {
+        gpioevent_data event{};
+        // uAPI v1 timestamps are taken by CLOCK_REALTIME on kernels older than 5.7
+        auto timestamp = time.time_since_epoch();
+        if (!TInterruptionContext::InterruptTimestampClockIsMonotonic) {
+            timestamp += Clock->GetRealtimeOffset();
+        }
+        event.timestamp = chrono::duration_cast<chrono::nanoseconds>(timestamp).count();
+        event.id = isRising ? GPIOEVENT_EVENT_RISING_EDGE : GPIOEVENT_EVENT_FALLING_EDGE;
+        size = write(request.WriteFd, &event, sizeof(event));
+    } else {
+        gpio_v2_line_event event{};
+        event.timestamp_ns = chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch()).count();
+        event.id = isRising ? GPIO_V2_LINE_EVENT_RISING_EDGE : GPIO_V2_LINE_EVENT_FALLING_EDGE;
+        event.offset = offset;
+        event.seqno = ++request.Seqno;
+        event.line_seqno = ++line.Seqno;
+        size = write(request.WriteFd, &event, sizeof(event));
+    }
+    if (size <= 0) {
+        ++DroppedEvents;
+    }
+}
+
+TSimulatedGpioBackend::TChip* TSimulatedGpioBackend::FindChip(int chipFd)
+{
+    auto itChip = ChipFds.find(chipFd);
+    if (itChip == ChipFds.end()) {
+        return nullptr;
+    }
+    return &Chips.at(itChip->second);
+}
+
+TSimulatedGpioBackend::TRequest* TSimulatedGpioBackend::FindRequest(int fd)
+{
+    auto itRequest = Requests.find(fd);
+    return (itRequest == Requests.end()) ? nullptr : &itRequest->second;
+}
+
+int TSimulatedGpioBackend::AddRequest(TChip& chip, TRequest&& request, const char* consumer)
+{
+    for (auto offset: request.Offsets) {
+        if (offset >= chip.Lines.size()) {
+            return Fail(EINVAL);
+        }
+        if (chip.Lines[offset].RequestFd >= 0) {
+            return Fail(EBUSY);
+        }
+    }
+
+    int fd;
+    if (request.Flags & (GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING)) {
+        int fds[2];
+        if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+            return -1;
+        }
+        fd = fds[0];
+        request.WriteFd = fds[1];
+    } else {
+        // request without events is never readable
+        fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0) {
+            return -1;
+        }
+        request.WriteFd = -1;
+    }
+
+    for (auto offset: request.Offsets) {
+        auto& line = chip.Lines[offset];
+        line.RequestFd = fd;
+        line.Flags = request.Flags;
+        line.Consumer = consumer;
+    }
+    request.ChipPath = chip.Config.Path;
+    request.Seqno = 0;
+    Requests[fd] = move(request);
+    return fd;
+}
+
+int TSimulatedGpioBackend::OpenChip(const string& path)
+{
+    lock_guard<mutex> lock(Mutex);
+    if (!Chips.count(path)) {
+        return Fail(ENOENT);
+    }
+    auto fd = eventfd(0, EFD_CLOEXEC);
+    if (fd >= 0) {
+        ChipFds[fd] = path;
+    }
+    return fd;
+}
+
+int TSimulatedGpioBackend::Close(int fd)
+{
+    lock_guard<mutex> lock(Mutex);
+    ChipFds.erase(fd);
+
+    if (auto request = FindRequest(fd)) {
+        auto& chip = Chips.at(request->ChipPath);
+        for (auto offset: request->Offsets) {
+            auto& line = chip.Lines[offset];
+            line.RequestFd = -1;
+            line.Flags = 0;
+            line.DebouncePeriodUs = 0;
+            line.Consumer.clear();
+        }
+        if (request->WriteFd >= 0) {
+            close(request->WriteFd);
+        }
+        Requests.erase(fd);
+    }
+    return close(fd);
+}
+
+int TSimulatedGpioBackend::GetChipInfo(int chipFd, gpiochip_info& info)
+{
+    lock_guard<mutex> lock(Mutex);
+    auto chip = FindChip(chipFd);
+    if (!chip) {
+        return Fail(EBADF);
+    }
+    const auto& path = chip->Config.Path;
+    CopyString(info.name, path.substr(path.rfind('/') + 1));
+    CopyString(info.label, chip->Config.Label);
+    info.lines = chip->Config.LineCount;
+    return 0;
+}
+
+int TSimulatedGpioBackend::GetLineInfo(int chipFd, gpioline_info& info)
+{
+    lock_guard<mutex> lock(Mutex);
+    auto chip = FindChip(chipFd);
+    if (!chip) {
+        return Fail(EBADF);
+    }
+    if (info.line_offset >= chip->Lines.size()) {
+        return Fail(EINVAL);
+    }
+    const auto& line = chip->Lines[info.line_offset];
+    info.flags = (line.RequestFd >= 0) ? GetHandleFlagsFromV2Flags(line.Flags) : 0;
+    info.name[0] = '\0';
+    CopyString(info.consumer, line.Consumer);
+    return 0;
+}
+
+int TSimulatedGpioBackend::GetLineInfo(int chipFd, gpio_v2_line_info& info)
+{
+    lock_guard<mutex> lock(Mutex);
+    auto chip = FindChip(chipFd);
+    if (!chip) {
+        return Fail(EBADF);
+    }
+    if (!chip->Config.UapiV2Supported) {
+        return Fail(EINVAL);
+    }
+    if (info.offset >= chip->Lines.size()) {
+        return Fail(EINVAL);
+    }
+    const auto& line = chip->Lines[info.offset];
+    info.flags = (line.RequestFd >= 0) ? (line.Flags | GPIO_V2_LINE_FLAG_USED) : GPIO_V2_LINE_FLAG_INPUT;
+    info.name[0] = '\0';
+    CopyString(info.consumer, line.Consumer);
+    info.num_attrs = 0;
+    if (line.DebouncePeriodUs > 0) {
+        info.attrs[0].id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+        info.attrs[0].debounce_period_us = line.DebouncePeriodUs;
+        info.num_attrs = 1;
+    }
+    return 0;
+}
+
+int TSimulatedGpioBackend::RequestLineHandle(int chipFd, gpiohandle_request& req)
+{
+    lock_guard<mutex> lock(Mutex);
+    auto chip = FindChip(chipFd);
+    if (!chip) {
+        return Fail(EBADF);
+    }
+    if (req.lines == 0 || req.lines > GPIOHANDLES_MAX) {
+        return Fail(EINVAL);
+    }
+
+    TRequest request{ERequestType::HANDLE, {}, {}, GetV2FlagsFromHandleFlags(req.flags), -1, 0};
+    request.Offsets.assign(req.lineoffsets, req.lineoffsets + req.lines);
+    auto fd = AddRequest(*chip, move(request), req.consumer_label);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (req.flags & GPIOHANDLE_REQUEST_OUTPUT) {
+        bool isActiveLow = req.flags & GPIOHANDLE_REQUEST_ACTIVE_LOW;
+        for (uint32_t i = 0; i < req.lines; ++i) {
+            chip->Lines[req.lineoffsets[i]].Level = (req.default_values[i] != 0) != isActiveLow;
+        }
+    }
+    req.fd = fd;
+    return 0;
+}
+
+int TSimulatedGpioBackend::RequestLineEvent(int chipFd, gpioevent_request& req)
+{
+    lock_guard<mutex> lock(Mutex);
+    auto chip = FindChip(chipFd);
+    if (!chip) {
+        return Fail(EBADF);
+    }
+    if (!chip->Config.InterruptsSupported) {
+        return Fail(ENXIO);
+    }
+    if (req.handleflags & GPIOHANDLE_REQUEST_OUTPUT) {
+        return Fail(EINVAL);
+    }
+
+    auto flags = GetV2FlagsFromHandleFlags(req.handleflags) | GPIO_V2_LINE_FLAG_INPUT;
+    if (req.eventflags & GPIOEVENT_REQUEST_RISING_EDGE)
+        flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+    if (req.eventflags & GPIOEVENT_REQUEST_FALLING_EDGE)
+        flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+
+    TRequest request{ERequestType::EVENT_V1, {}, {req.lineoffset}, flags, -1, 0};
+    auto fd = AddRequest(*chip, move(request), req.consumer_label);
+    if (fd < 0) {
+        return -1;
+    }
+    req.fd = fd;
+    return 0;
+}
+
+int TSimulatedGpioBackend::RequestLines(int chipFd, gpio_v2_line_request& req)
+{
+    lock_guard<mutex> lock(Mutex);
+    auto chip = FindChip(chipFd);
+    if (!chip) {
+        return Fail(EBADF);
+    }
+    if (!chip->Config.UapiV2Supported || req.num_lines == 0 || req.num_lines > GPIO_V2_LINES_MAX) {
+        return Fail(EINVAL);
+    }
+    auto flags = req.config.flags;
+    if ((flags & (GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING)) &&
+        !chip->Config.InterruptsSupported)
+    {
+        return Fail(ENXIO);
+    }
+
+    TRequest request{ERequestType::LINES_V2, {}, {}, flags, -1, 0};
+    request.Offsets.assign(req.offsets, req.offsets + req.num_lines);
+    auto fd = AddRequest(*chip, move(request), req.consumer);
+    if (fd < 0) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < req.config.num_attrs; ++i) {
+        const auto& attr = req.config.attrs[i];
+        if (attr.attr.id != GPIO_V2_LINE_ATTR_ID_DEBOUNCE) {
+            continue;
+        }
+        for (uint32_t j = 0; j < req.num_lines; ++j) {
+            if (attr.mask & (1ULL << j)) {
+                chip->Lines[req.offsets[j]].DebouncePeriodUs = attr.attr.debounce_period_us;
+            }
+        }
+    }
+    req.fd = fd;
+    return 0;
+}
+
+int TSimulatedGpioBackend::GetLineValues(int fd, gpiohandle_data& data)
+{
+    chrono::nanoseconds latency;
+    {
+        lock_guard<mutex> lock(Mutex);
+        auto request = FindRequest(fd);
+        if (!request) {
+            return Fail(EBADF);
+        }
+        if (request->Type == ERequestType::LINES_V2) {
+            return Fail(ENOTTY);
+        }
+        const auto& chip = Chips.at(request->ChipPath);
+        for (size_t i = 0; i < request->Offsets.size(); ++i) {
+            data.values[i] = GetLogicalValue(request->Flags, chip.Lines[request->Offsets[i]].Level);
+        }
+        latency = chip.Config.ReadLatency;
+    }
+    SimulateBusTransfer(latency);
+    return 0;
+}
+
+int TSimulatedGpioBackend::SetLineValues(int fd, gpiohandle_data& data)
+{
+    chrono::nanoseconds latency;
+    {
+        lock_guard<mutex> lock(Mutex);
+        auto request = FindRequest(fd);
+        if (!request) {
+            return Fail(EBADF);
+        }
+        if (request->Type != ERequestType::HANDLE || !(request->Flags & GPIO_V2_LINE_FLAG_OUTPUT)) {
+            return Fail(EPERM);
+        }
+        auto& chip = Chips.at(request->ChipPath);
+        auto now = Clock->Now();
+        for (size_t i = 0; i < request->Offsets.size(); ++i) {
+            bool level = GetLogicalValue(request->Flags, data.values[i] != 0);
+            ChangeLevel(chip, request->Offsets[i], level, now, true);
+        }
+        latency = chip.Config.ReadLatency;
+    }
+    SimulateBusTransfer(latency);
+    return 0;
+}
+
+int TSimulatedGpioBackend::GetLineValues(int fd, gpio_v2_line_values& values)
+{
+    chrono::nanoseconds latency;
+    {
+        lock_guard<mutex> lock(Mutex);
+        auto request = FindRequest(fd);
+        if (!request) {
+            return Fail(EBADF);
+        }
+        if (request->Type != ERequestType::LINES_V2) {
+            return Fail(ENOTTY);
+        }
+        const auto& chip = Chips.at(request->ChipPath);
+        uint64_t bits = 0;
+        for (size_t i = 0; i < request->Offsets.size(); ++i) {
+            if (GetLogicalValue(request->Flags, chip.Lines[request->Offsets[i]].Level)) {
+                bits |= 1ULL << i;
+            }
+        }
+        values.bits = bits & values.mask;
+        latency = chip.Config.ReadLatency;
+    }
+    SimulateBusTransfer(latency);
+    return 0;
+}
+
+int TSimulatedGpioBackend::SetLineConfig(int fd, gpio_v2_line_config& config)
+{
+    lock_guard<mutex> lock(Mutex);
+    auto request = FindRequest(fd);
+    if (!request) {
+        return Fail(EBADF);
+    }
+    if (request->Type != ERequestType::LINES_V2) {
+        return Fail(ENOTTY);
+    }
+    auto& chip = Chips.at(request->ChipPath);
+    for (size_t i = 0; i < request->Offsets.size(); ++i) {
+        auto& line = chip.Lines[request->Offsets[i]];
+        line.Flags = config.flags;
+        line.DebouncePeriodUs = 0;
+        for (uint32_t j = 0; j < config.num_attrs; ++j) {
+            const auto& attr = config.attrs[j];
+            if (!(attr.mask & (1ULL << i))) {
+                continue;
+            }
+            if (attr.attr.id == GPIO_V2_LINE_ATTR_ID_FLAGS) {
+                line.Flags = attr.attr.flags;
+            } else if (attr.attr.id == GPIO_V2_LINE_ATTR_ID_DEBOUNCE) {
+                line.DebouncePeriodUs = attr.attr.debounce_period_us;
+            }
+        }
+    }
+    return 0;
+}
+
+TSimulatedEdgeGenerator::TSimulatedEdgeGenerator(const PSimulatedGpioBackend& backend,
+                                                 const vector<TSimulatedSignal>& signals)
+    : Backend(backend),
+      Signals(signals),
+      Active(false),
+      ToggleCount(0)
+{}
+
+TSimulatedEdgeGenerator::~TSimulatedEdgeGenerator()
+{
+    Stop();
+}
+
+void TSimulatedEdgeGenerator::Start()
+{
+    Active = true;
+    Worker = WBMQTT::MakeThread("GPIO simulator", {[this] { Run(); }});
+}
+
+void TSimulatedEdgeGenerator::Stop()
+{
+    if (!Worker) {
+        return;
+    }
+    Active = false;
+    if (Worker->joinable()) {
+        Worker->join();
+    }
+    Worker.reset();
+}
+
+uint64_t TSimulatedEdgeGenerator::GetToggleCount() const
+{
+    return ToggleCount;
+}
+
+void TSimulatedEdgeGenerator::Run()
+{
+    if (Signals.empty()) {
+        return;
+    }
+
+    auto start = chrono::steady_clock::now();
+    vector<TTimePoint> nextToggles;
+    for (const auto& signal: Signals) {
+        nextToggles.push_back(start + signal.Period);
+    }
+
+    while (Active) {
+        auto itNext = min_element(nextToggles.begin(), nextToggles.end());
+        this_thread::sleep_until(min(*itNext, chrono::steady_clock::now() + GENERATOR_STOP_CHECK_INTERVAL));
+        if (chrono::steady_clock::now() < *itNext) {
+            continue;
+        }
+
+        const auto& signal = Signals[itNext - nextToggles.begin()];
+        Backend->Toggle(signal.Path, signal.Offset, signal.Bounce);
+        ++ToggleCount;
+        *itNext += signal.Period;
+    }
+}
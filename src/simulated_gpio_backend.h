@@ -0,0 +1,166 @@
+#pragma once
+
+#include "clock.h"
+#include "gpio_backend.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/* Contact bounce: short pulses of opposite level before line settles */
+struct TBounceProfile
+{
+    uint32_t Count = 0;                      // number of pulses
+    std::chrono::microseconds Interval{100}; // between consecutive transitions
+};
+
+struct TSimulatedGpioChipConfig
+{
+    std::string Path; // /dev/gpiochipN, its number is used in line descriptions. Filesystem is not touched
+    std::string Label = "simulated";
+    uint32_t LineCount = 32;
+    bool UapiV2Supported = true;
+    bool InterruptsSupported = true;         // false - lines can only be polled, like expanders without IRQ
+    std::chrono::nanoseconds ReadLatency{0}; // added to every value read and write, e.g. bus transfer of expander
+};
+
+/**
+ * @brief In-process GPIO chips for tests and benchmarks without GPIO hardware.
+ *        Line requests are backed by pipes: edges of requested lines are written to them
+ *        as kernel event records and are read by the driver as from fds of kernel requests.
+ *        Events that don't fit into pipe are dropped, like kernel drops them on overflow of its fifo.
+ *        Thread-safe: lines may be driven from other threads while the driver works.
+ */
+class TSimulatedGpioBackend: public TGpioBackend
+{
+    enum class ERequestType
+    {
+        HANDLE,
+        EVENT_V1,
+        LINES_V2
+    };
+
+    struct TRequest
+    {
+        ERequestType Type;
+        std::string ChipPath;
+        std::vector<uint32_t> Offsets;
+        uint64_t Flags; // uAPI v2 flags of lines
+        int WriteFd;    // end of events pipe, -1 if request has no events
+        uint32_t Seqno;
+    };
+
+    struct TLine
+    {
+        bool Level = false; // physical
+        int RequestFd = -1;
+        uint64_t Flags = 0; // uAPI v2 flags of request
+        uint32_t DebouncePeriodUs = 0;
+        uint32_t Seqno = 0;
+        std::string Consumer;
+    };
+
+    struct TChip
+    {
+        TSimulatedGpioChipConfig Config;
+        std::vector<TLine> Lines;
+    };
+
+    PClock Clock; // timestamps of events
+    mutable std::mutex Mutex;
+    std::map<std::string, TChip> Chips;
+    std::unordered_map<int, std::string> ChipFds;
+    std::unordered_map<int, TRequest> Requests;
+    std::atomic<uint64_t> DroppedEvents;
+
+public:
+    explicit TSimulatedGpioBackend(const PClock& clock = GetSteadyClock());
+    ~TSimulatedGpioBackend();
+
+    void AddChip(const TSimulatedGpioChipConfig& config);
+
+    /* Sets physical level of line. Emits event if line is requested for the edge */
+    void SetLevel(const std::string& path, uint32_t offset, bool level);
+
+    /* Changes physical level of line to opposite, preceded by bounce pulses.
+       Lines debounced by kernel report only settled level if bounce is shorter than debounce period */
+    void Toggle(const std::string& path, uint32_t offset, const TBounceProfile& bounce = TBounceProfile());
+
+    bool GetLevel(const std::string& path, uint32_t offset) const;
+
+    /* Sets logical level of line as its request reads it and emits event of the level even if it is unchanged,
+       as kernel reports edges of pulses too short to be read. Bypasses kernel debounce: replays recorded events */
+    void InjectEdge(const std::string& path, uint32_t offset, bool value);
+
+    /* Sets logical level of line as its request reads it, without event */
+    void SetValue(const std::string& path, uint32_t offset, bool value);
+
+    /* Number of events dropped because reader did not keep up */
+    uint64_t GetDroppedEventCount() const;
+
+    int OpenChip(const std::string& path) override;
+    int Close(int fd) override;
+
+    int GetChipInfo(int chipFd, gpiochip_info& info) override;
+    int GetLineInfo(int chipFd, gpioline_info& info) override;
+    int GetLineInfo(int chipFd, gpio_v2_line_info& info) override;
+
+    int RequestLineHandle(int chipFd, gpiohandle_request& req) override;
+    int RequestLineEvent(int chipFd, gpioevent_request& req) override;
+    int RequestLines(int chipFd, gpio_v2_line_request& req) override;
+
+    int GetLineValues(int fd, gpiohandle_data& data) override;
+    int SetLineValues(int fd, gpiohandle_data& data) override;
+    int GetLineValues(int fd, gpio_v2_line_values& values) override;
+    int SetLineConfig(int fd, gpio_v2_line_config& config) override;
+
+private:
+    TChip* FindChip(int chipFd);
+    TRequest* FindRequest(int fd);
+    int AddRequest(TChip& chip, TRequest&& request, const char* consumer);
+    void ChangeLevel(TChip& chip, uint32_t offset, bool level, const TTimePoint& time, bool isSettled);
+    void WriteEvent(TRequest& request, TLine& line, uint32_t offset, bool isRising, const TTimePoint& time);
+};
+
+using PSimulatedGpioBackend = std::shared_ptr<TSimulatedGpioBackend>;
+
+/* Periodically toggled line of simulated chip */
+struct TSimulatedSignal
+{
+    std::string Path;
+    uint32_t Offset = 0;
+    std::chrono::microseconds Period{1000}; // between toggles
+    TBounceProfile Bounce;
+};
+
+/**
+ * @brief Drives lines of simulated chips from its own thread, each at rate of its signal.
+ *        Late toggles are not skipped, so a slow reader sees the configured number of edges.
+ *        Runs in real time, so the backend must use steady clock.
+ */
+class TSimulatedEdgeGenerator
+{
+    PSimulatedGpioBackend Backend;
+    std::vector<TSimulatedSignal> Signals;
+    std::unique_ptr<std::thread> Worker;
+    std::atomic_bool Active;
+    std::atomic<uint64_t> ToggleCount;
+
+public:
+    TSimulatedEdgeGenerator(const PSimulatedGpioBackend& backend, const std::vector<TSimulatedSignal>& signals);
+    ~TSimulatedEdgeGenerator();
+
+    void Start();
+    void Stop();
+
+    /* Number of settled level changes made so far */
+    uint64_t GetToggleCount() const;
+
+private:
+    void Run();
+};
@@ -0,0 +1,217 @@
+#include "timer_queue.h"
+#include "exceptions.h"
+#include "gpio_line.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cassert>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#define LOG(logger) ::logger.Log() << "[timer queue] "
+
+using namespace std;
+
+TTimerQueue::TTimerQueue(const PClock& clock, TPositionSlot positionSlot)
+    : IsSimulated(clock->IsSimulated()),
+      PositionSlot(positionSlot),
+      ArmedDeadline(TTimePoint::max())
+{
+    Fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (Fd == -1) {
+        LOG(Error) << "timerfd_create failed: " << strerror(errno);
+        wb_throw(TGpioDriverException, "unable to create timer: timerfd_create failed with " + string(strerror(errno)));
+    }
+}
+
+TTimerQueue::~TTimerQueue()
+{
+    if (PositionSlot) {
+        for (auto& entry: Entries) {
+            ((*entry.Line).*PositionSlot)() = NO_POSITION;
+        }
+    }
+    close(Fd);
+}
+
+int TTimerQueue::GetFd() const
+{
+    return Fd;
+}
+
+bool TTimerQueue::IsEmpty() const
+{
+    return Entries.empty();
+}
+
+TTimePoint TTimerQueue::GetEarliestDeadline() const
+{
+    return Entries.empty() ? TTimePoint::max() : Entries.front().Deadline;
+}
+
+void TTimerQueue::Reserve(size_t count)
+{
+    Entries.reserve(count);
+}
+
+void TTimerQueue::Schedule(const PGpioLine& line, const TTimePoint& deadline)
+{
+    assert(!PositionSlot || ((*line).*PositionSlot)() == NO_POSITION);
+
+    Entries.push_back({deadline, line});
+    SiftUp(Entries.size() - 1);
+
+    if (deadline < ArmedDeadline) {
+        Arm(deadline);
+    }
+}
+
+void TTimerQueue::Advance(const PGpioLine& line, const TTimePoint& deadline)
+{
+    assert(PositionSlot);
+
+    auto position = ((*line).*PositionSlot)();
+    if (position == NO_POSITION) {
+        Schedule(line, deadline);
+        return;
+    }
+    assert(Entries[position].Line == line);
+    if (deadline >= Entries[position].Deadline) {
+        return;
+    }
+    // earlier deadline only sifts the entry up
+    Entries[position].Deadline = deadline;
+    SiftUp(position);
+
+    if (deadline < ArmedDeadline) {
+        Arm(deadline);
+    }
+}
+
+void TTimerQueue::Acknowledge(const TTimePoint& now)
+{
+    uint64_t expirations;
+    if (!IsSimulated && read(Fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+        LOG(Error) << "timerfd read failed: " << strerror(errno);
+    }
+
+    if (ArmedDeadline != TTimePoint::max() && ArmedDeadline <= now) {
+        auto latency = now - ArmedDeadline;
+        ++LatencyStats.Count;
+        LatencyStats.Total += latency;
+        LatencyStats.Max = max<chrono::nanoseconds>(LatencyStats.Max, latency);
+    }
+
+    ArmedDeadline = TTimePoint::max();
+}
+
+bool TTimerQueue::PopExpired(const TTimePoint& now, PGpioLine& line)
+{
+    if (Entries.empty() || Entries.front().Deadline > now) {
+        return false;
+    }
+    line = move(Entries.front().Line);
+    if (PositionSlot) {
+        ((*line).*PositionSlot)() = NO_POSITION;
+    }
+    auto last = move(Entries.back());
+    Entries.pop_back();
+    if (!Entries.empty()) {
+        Place(0, move(last));
+        SiftDown(0);
+    }
+    return true;
+}
+
+void TTimerQueue::Rearm()
+{
+    if (!Entries.empty() && Entries.front().Deadline < ArmedDeadline) {
+        Arm(Entries.front().Deadline);
+    }
+}
+
+void TTimerQueue::SiftUp(size_t position)
+{
+    auto entry = move(Entries[position]);
+    while (position > 0) {
+        auto parent = (position - 1) / 2;
+        if (Entries[parent].Deadline <= entry.Deadline) {
+            break;
+        }
+        Place(position, move(Entries[parent]));
+        position = parent;
+    }
+    Place(position, move(entry));
+}
+
+void TTimerQueue::SiftDown(size_t position)
+{
+    auto entry = move(Entries[position]);
+    for (;;) {
+        auto child = 2 * position + 1;
+        if (child >= Entries.size()) {
+            break;
+        }
+        if (child + 1 < Entries.size() && Entries[child + 1].Deadline < Entries[child].Deadline) {
+            ++child;
+        }
+        if (entry.Deadline <= Entries[child].Deadline) {
+            break;
+        }
+        Place(position, move(Entries[child]));
+        position = child;
+    }
+    Place(position, move(entry));
+}
+
+void TTimerQueue::Place(size_t position, TEntry&& entry)
+{
+    Entries[position] = move(entry);
+    if (PositionSlot) {
+        ((*Entries[position].Line).*PositionSlot)() = position;
+    }
+}
+
+TTimerQueue::TLatencyStats TTimerQueue::TakeLatencyStats()
+{
+    auto stats = LatencyStats;
+    LatencyStats = TLatencyStats();
+    return stats;
+}
+
+void TTimerQueue::TLatencyStats::Add(const TLatencyStats& other)
+{
+    Count += other.Count;
+    Total += other.Total;
+    Max = max(Max, other.Max);
+}
+
+void TTimerQueue::Arm(const TTimePoint& deadline)
+{
+    if (IsSimulated) {
+        ArmedDeadline = deadline;
+        return;
+    }
+
+    auto sinceEpoch = deadline.time_since_epoch();
+    auto sec = chrono::floor<chrono::seconds>(sinceEpoch);
+    auto nsec = chrono::duration_cast<chrono::nanoseconds>(sinceEpoch - sec);
+
+    itimerspec ts{};
+    ts.it_value.tv_sec = sec.count();
+    ts.it_value.tv_nsec = nsec.count();
+
+    // zero it_value disarms the timer, so deadlines at or before the very epoch are moved a bit
+    if (ts.it_value.tv_sec < 0 || (ts.it_value.tv_sec == 0 && ts.it_value.tv_nsec == 0)) {
+        ts.it_value.tv_sec = 0;
+        ts.it_value.tv_nsec = 1;
+    }
+
+    if (timerfd_settime(Fd, TFD_TIMER_ABSTIME, &ts, nullptr) < 0) {
+        LOG(Error) << "timerfd_settime failed: " << strerror(errno);
+        wb_throw(TGpioDriverException, "unable to setup timer: timerfd_settime failed with " + string(strerror(errno)));
+    }
+
+    ArmedDeadline = deadline;
+}
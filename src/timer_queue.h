@@ -0,0 +1,95 @@
+#pragma once
+
+#include "clock.h"
+#include "declarations.h"
+
+#include <chrono>
+#include <limits>
+#include <vector>
+
+/**
+ * @brief Min-heap of line deadlines backed by a single timerfd.
+ *        The timerfd is re-armed only if the earliest deadline moves,
+ *        so scheduling a deadline costs no syscall in most cases.
+ *        Deadlines of simulated clock don't arm the timerfd, owner of the clock handles them.
+ *        Queue with position slot keeps position of every entry in the line, so Advance() finds it without search.
+ */
+class TTimerQueue
+{
+    struct TEntry
+    {
+        TTimePoint Deadline;
+        PGpioLine Line;
+    };
+
+public:
+    /* Field of line with position of its entry in the heap, e.g. &TGpioLine::AccessDebounceQueuePosition */
+    using TPositionSlot = size_t& (TGpioLine::*)();
+
+    static constexpr size_t NO_POSITION = std::numeric_limits<size_t>::max(); // line is not in the queue
+
+    /* Delays between armed deadlines and their actual handling */
+    struct TLatencyStats
+    {
+        uint64_t Count = 0;
+        std::chrono::nanoseconds Total = std::chrono::nanoseconds::zero();
+        std::chrono::nanoseconds Max = std::chrono::nanoseconds::zero();
+
+        void Add(const TLatencyStats& other);
+    };
+
+private:
+    int Fd;
+    bool IsSimulated;
+    TPositionSlot PositionSlot; // nullptr - positions are not kept
+    std::vector<TEntry> Entries; // min-heap of deadlines
+    TTimePoint ArmedDeadline;
+    TLatencyStats LatencyStats;
+
+public:
+    explicit TTimerQueue(const PClock& clock = GetSteadyClock(), TPositionSlot positionSlot = nullptr);
+    ~TTimerQueue();
+
+    TTimerQueue(const TTimerQueue&) = delete;
+    TTimerQueue& operator=(const TTimerQueue&) = delete;
+
+    int GetFd() const;
+    bool IsEmpty() const;
+
+    /* TTimePoint::max() if queue is empty */
+    TTimePoint GetEarliestDeadline() const;
+
+    /* Preallocates room for deadlines, so scheduling up to that many of them does not allocate */
+    void Reserve(size_t count);
+
+    void Schedule(const PGpioLine& line, const TTimePoint& deadline);
+
+    /* Moves deadline of line to an earlier one or schedules it if line has none,
+       so the queue keeps a single deadline per line. Requires position slot */
+    void Advance(const PGpioLine& line, const TTimePoint& deadline);
+
+    /* Consumes timerfd expiration, calls handler for every line with deadline <= now and re-arms timer */
+    template<typename THandler> void HandleExpired(const TTimePoint& now, THandler&& handler)
+    {
+        Acknowledge(now);
+
+        PGpioLine line;
+        while (PopExpired(now, line)) {
+            handler(line); // may schedule new deadlines
+        }
+
+        Rearm();
+    }
+
+    /* Returns latency stats collected since previous call */
+    TLatencyStats TakeLatencyStats();
+
+private:
+    void Acknowledge(const TTimePoint& now);
+    bool PopExpired(const TTimePoint& now, PGpioLine& line);
+    void Rearm();
+    void SiftUp(size_t position);
+    void SiftDown(size_t position);
+    void Place(size_t position, TEntry&& entry); // moves entry to position and stores it in the line
+    void Arm(const TTimePoint& deadline);
+};
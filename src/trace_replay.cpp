@@ -0,0 +1,340 @@
+#include "trace_replay.h"
+#include "clock.h"
+#include "edge_trace.h"
+#include "exceptions.h"
+#include "gpio_chip_driver.h"
+#include "gpio_counter.h"
+#include "gpio_line.h"
+#include "interruption_context.h"
+#include "log.h"
+#include "simulated_gpio_backend.h"
+
+#include <algorithm>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#define LOG(logger) ::logger.Log() << "[trace replay] "
+
+using namespace std;
+
+namespace
+{
+    const int EPOLL_EVENT_COUNT = 20;
+
+    struct TReplayEvent
+    {
+        TTimePoint Time;
+        EEdgeTraceRecordType Type;
+        uint16_t Id;
+        uint64_t Values;
+    };
+
+    /* Line of trace matched to a line of config */
+    struct TReplayLine
+    {
+        TEdgeTraceRecord Record; // LINE
+        string ChipPath;
+        PGpioLine Line;
+        TGpioChipDriver* Driver = nullptr;
+    };
+
+    /* Chip drivers on simulated chips and clock, all added to one epoll */
+    class TReplay
+    {
+        const TTraceReplay::TPublishHandler& Publish;
+        PSimulatedClock Clock;
+        PSimulatedGpioBackend Backend;
+        vector<unique_ptr<TGpioChipDriver>> Drivers;
+        int Epfd;
+
+    public:
+        TReplay(const TTraceReplay::TPublishHandler& publish, const TTimePoint& start)
+            : Publish(publish),
+              Clock(make_shared<TSimulatedClock>(start)),
+              Backend(make_shared<TSimulatedGpioBackend>(Clock)),
+              Epfd(epoll_create(1))
+        {
+            if (Epfd < 0) {
+                wb_throw(TGpioDriverException, "epoll_create failed with " + string(strerror(errno)));
+            }
+        }
+
+        ~TReplay()
+        {
+            Drivers.clear();
+            close(Epfd);
+        }
+
+        const PSimulatedGpioBackend& GetBackend() const
+        {
+            return Backend;
+        }
+
+        TGpioChipDriver* AddDriver(const TGpioChipConfig& config)
+        {
+            Drivers.push_back(make_unique<TGpioChipDriver>(config, Backend, Clock));
+            Drivers.back()->AddToEpoll(Epfd);
+            return Drivers.back().get();
+        }
+
+        void SetTime(const TTimePoint& time)
+        {
+            Clock->SetTime(max(time, Clock->Now()));
+        }
+
+        /* Handles timers of all drivers with deadlines before time, publishing changes of every fired batch */
+        void RunTimersUntil(const TTimePoint& time)
+        {
+            for (auto deadline = GetNextTimerDeadline(); deadline < time; deadline = GetNextTimerDeadline()) {
+                SetTime(deadline);
+                for (const auto& driver: Drivers) {
+                    driver->HandleTimers();
+                }
+                PublishChanges();
+            }
+        }
+
+        /* Handles timers until debounce, counters and storms of all lines settle. Polls alone don't keep it running */
+        void RunPendingTimers()
+        {
+            while (IsPending()) {
+                auto deadline = GetNextTimerDeadline();
+                if (deadline == TTimePoint::max()) {
+                    break;
+                }
+                RunTimersUntil(deadline + chrono::nanoseconds(1));
+            }
+        }
+
+        void DispatchEvents()
+        {
+            struct epoll_event events[EPOLL_EVENT_COUNT]{};
+            while (int count = epoll_wait(Epfd, events, EPOLL_EVENT_COUNT, 0)) {
+                if (count < 0) {
+                    wb_throw(TGpioDriverException, "epoll_wait failed with " + string(strerror(errno)));
+                }
+                TInterruptionContext ctx{count, events};
+                TGpioChipDriver::HandleInterrupt(ctx);
+            }
+        }
+
+        void PublishChanges()
+        {
+            TControlUpdates updates;
+            for (const auto& driver: Drivers) {
+                driver->ForEachDirtyLine([&updates](const PGpioLine& line) { AppendControlUpdates(line, updates); });
+            }
+            if (!updates.empty()) {
+                Publish(Clock->Now(), updates);
+            }
+        }
+
+    private:
+        TTimePoint GetNextTimerDeadline() const
+        {
+            auto deadline = TTimePoint::max();
+            for (const auto& driver: Drivers) {
+                deadline = min(deadline, driver->GetNextTimerDeadline());
+            }
+            return deadline;
+        }
+
+        bool IsPending() const
+        {
+            bool isPending = false;
+            for (const auto& driver: Drivers) {
+                driver->ForEachLine([&isPending](const PGpioLine& line) {
+                    isPending |= line->IsDebouncePending() || line->IsCounterUpdatePending() ||
+                                 line->IsInterruptStorm();
+                });
+            }
+            return isPending;
+        }
+    };
+
+    void CheckId(uint16_t id, size_t count, const char* what)
+    {
+        if (id >= count) {
+            wb_throw(TGpioDriverException, string("trace file refers to undefined ") + what + " " + to_string(id));
+        }
+    }
+}
+
+TTraceReplay::TTraceReplay(const TGpioDriverConfig& config): Config(config)
+{}
+
+size_t TTraceReplay::Run(const std::string& traceFile, const TPublishHandler& publish)
+{
+    TEdgeTraceReader reader(traceFile);
+
+    vector<TReplayLine> lines;
+    vector<vector<uint16_t>> groups;
+    vector<TReplayEvent> events;
+
+    TEdgeTraceRecord record;
+    while (reader.Next(record)) {
+        switch (record.Type) {
+            case EEdgeTraceRecordType::LINE: {
+                if (record.Id != lines.size()) {
+                    wb_throw(TGpioDriverException, "unexpected id " + to_string(record.Id) + " of line in trace file");
+                }
+                lines.push_back({record});
+                break;
+            }
+            case EEdgeTraceRecordType::GROUP: {
+                if (record.Id != groups.size()) {
+                    wb_throw(TGpioDriverException,
+                             "unexpected id " + to_string(record.Id) + " of line group in trace file");
+                }
+                for (auto lineId: record.LineIds) {
+                    CheckId(lineId, lines.size(), "line");
+                }
+                groups.push_back(record.LineIds);
+                break;
+            }
+            case EEdgeTraceRecordType::POLL: {
+                CheckId(record.Id, groups.size(), "line group");
+                events.push_back({record.Time, record.Type, record.Id, record.Values});
+                break;
+            }
+            case EEdgeTraceRecordType::EDGE:
+            case EEdgeTraceRecordType::LEVEL: {
+                CheckId(record.Id, lines.size(), "line");
+                events.push_back({record.Time, record.Type, record.Id, record.Values});
+                break;
+            }
+        }
+    }
+    if (events.empty()) {
+        return 0;
+    }
+
+    // lanes record their events concurrently, so the trace is ordered only per line
+    stable_sort(events.begin(), events.end(), [](const TReplayEvent& a, const TReplayEvent& b) {
+        return a.Time < b.Time;
+    });
+
+    // set up chips and lines as they were while recording
+    auto chipConfigs = Config.Chips;
+    vector<TSimulatedGpioChipConfig> simulatedChips;
+    for (const auto& chipConfig: chipConfigs) {
+        TSimulatedGpioChipConfig simulatedChip;
+        simulatedChip.Path = chipConfig.Path;
+        simulatedChip.LineCount = 0;
+        for (const auto& lineConfig: chipConfig.Lines) {
+            simulatedChip.LineCount = max(simulatedChip.LineCount, lineConfig.Offset + 1);
+        }
+        simulatedChips.push_back(simulatedChip);
+    }
+    for (auto& line: lines) {
+        const auto& traceLine = line.Record;
+        bool isFound = false;
+        for (size_t i = 0; i < chipConfigs.size() && !isFound; ++i) {
+            for (auto& lineConfig: chipConfigs[i].Lines) {
+                if (lineConfig.Name != traceLine.Name) {
+                    continue;
+                }
+                lineConfig.KernelDebounce = (traceLine.Flags & TEdgeTraceRecord::FLAG_DEBOUNCED_BY_KERNEL);
+                lineConfig.InterruptEdge = traceLine.CounterEdge;
+                if (traceLine.Flags & TEdgeTraceRecord::FLAG_POLLED) {
+                    simulatedChips[i].InterruptsSupported = false;
+                }
+                if (traceLine.Flags & TEdgeTraceRecord::FLAG_UAPI_V1) {
+                    simulatedChips[i].UapiV2Supported = false;
+                }
+                line.ChipPath = chipConfigs[i].Path;
+                isFound = true;
+                break;
+            }
+        }
+        if (!isFound) {
+            LOG(Warn) << "Line '" << traceLine.Name << "' is not configured, its records are skipped";
+        }
+    }
+
+    TReplay replay(publish, events.front().Time);
+    const auto& backend = replay.GetBackend();
+    for (const auto& simulatedChip: simulatedChips) {
+        backend->AddChip(simulatedChip);
+    }
+    // the state of lines recorded before their first events, lines are not requested yet, so level is physical
+    for (const auto& chipConfig: chipConfigs) {
+        for (const auto& lineConfig: chipConfig.Lines) {
+            auto itLine = find_if(lines.begin(), lines.end(), [&lineConfig](const TReplayLine& line) {
+                return line.Record.Name == lineConfig.Name;
+            });
+            if (itLine != lines.end()) {
+                bool value = itLine->Record.Values;
+                backend->SetLevel(chipConfig.Path, lineConfig.Offset, value != lineConfig.IsActiveLow);
+            }
+        }
+    }
+    for (const auto& chipConfig: chipConfigs) {
+        if (chipConfig.Lines.empty()) {
+            continue;
+        }
+        auto driver = replay.AddDriver(chipConfig);
+        driver->ForEachLine([&](const PGpioLine& driverLine) {
+            for (auto& line: lines) {
+                if (line.ChipPath == chipConfig.Path && line.Record.Name == driverLine->GetConfig()->Name) {
+                    line.Line = driverLine;
+                    line.Driver = driver;
+                    if (const auto& counter = driverLine->GetCounter()) {
+                        counter->SetInitialValues(line.Record.CounterTotal);
+                    }
+                }
+            }
+        });
+        driver->ForEachDirtyLine([](const PGpioLine&) {});
+    }
+
+    size_t count = 0;
+    vector<TGpioChipDriver*> readbackDrivers;
+    for (auto itEvent = events.begin(); itEvent != events.end(); ++itEvent) {
+        const auto& event = *itEvent;
+
+        // records of a time are applied before timers of the same time: the driver saw them when it woke up
+        replay.RunTimersUntil(event.Time);
+        replay.SetTime(event.Time);
+
+        if (event.Type == EEdgeTraceRecordType::POLL) {
+            const auto& group = groups[event.Id];
+            for (size_t i = 0; i < group.size(); ++i) {
+                const auto& line = lines[group[i]];
+                if (!line.Line) {
+                    continue;
+                }
+                backend->SetValue(line.ChipPath, line.Line->GetOffset(), (event.Values >> i) & 1);
+                // polled inputs are sampled by poll timer, other lines are read back by worker
+                if (!(line.Record.Flags & TEdgeTraceRecord::FLAG_POLLED) &&
+                    find(readbackDrivers.begin(), readbackDrivers.end(), line.Driver) == readbackDrivers.end())
+                {
+                    readbackDrivers.push_back(line.Driver);
+                }
+            }
+            ++count;
+        } else if (lines[event.Id].Line) {
+            const auto& line = lines[event.Id];
+            if (event.Type == EEdgeTraceRecordType::EDGE) {
+                backend->InjectEdge(line.ChipPath, line.Line->GetOffset(), event.Values);
+            } else {
+                backend->SetValue(line.ChipPath, line.Line->GetOffset(), event.Values);
+            }
+            ++count;
+        }
+
+        auto itNext = next(itEvent);
+        if (itNext == events.end() || itNext->Time != event.Time) {
+            replay.DispatchEvents();
+            for (auto driver: readbackDrivers) {
+                driver->PollLines();
+            }
+            readbackDrivers.clear();
+            replay.PublishChanges();
+        }
+    }
+    replay.RunPendingTimers();
+
+    return count;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "config.h"
+#include "declarations.h"
+#include "publish_queue.h"
+
+#include <functional>
+#include <string>
+
+/**
+ * @brief Replays trace recorded by TEdgeTraceWriter through chip drivers of config as fast as possible.
+ *        Chips are simulated: recorded edges are injected as kernel events, recorded levels and samples
+ *        are set to lines, and drivers read them by their own debounce, storm and poll schedule.
+ *        Clock is simulated: it jumps from record to record and timers of drivers fire exactly at their
+ *        deadlines, so results of the same trace and config are reproducible bit for bit.
+ *        Lines of trace are matched to config by name, records of unknown lines are skipped.
+ *        Chip does not support interrupts if any of its lines was polled, and uAPI v2 if any was read by v1.
+ */
+class TTraceReplay
+{
+public:
+    /* Called with changes of lines made by events or by timers expired at the same time */
+    using TPublishHandler = std::function<void(const TTimePoint& time, const TControlUpdates& updates)>;
+
+    explicit TTraceReplay(const TGpioDriverConfig& config);
+
+    /* Returns number of replayed records */
+    size_t Run(const std::string& traceFile, const TPublishHandler& publish);
+
+private:
+    TGpioDriverConfig Config;
+};
@@ -34,3 +34,35 @@ string GpioEdgeToString(EGpioEdge edge)
             return "<unknown (" + to_string((int)edge) + ")>";
     }
 }
+
+void EnumerateDebounceAlgorithm(const std::string& algorithm, EDebounceAlgorithm& enumAlgorithm)
+{
+    if (algorithm == "window")
+        enumAlgorithm = EDebounceAlgorithm::WINDOW;
+    else if (algorithm == "integrator")
+        enumAlgorithm = EDebounceAlgorithm::INTEGRATOR;
+    else if (algorithm == "majority")
+        enumAlgorithm = EDebounceAlgorithm::MAJORITY;
+    else if (algorithm == "pulse")
+        enumAlgorithm = EDebounceAlgorithm::PULSE;
+    else if (!algorithm.empty())
+        LOG(Warn) << "Unable to determine debounce algorithm from '" << algorithm
+                  << "': needs to be either 'window', 'integrator', 'majority' or 'pulse'. Using: '"
+                  << DebounceAlgorithmToString(enumAlgorithm) << "'";
+}
+
+string DebounceAlgorithmToString(EDebounceAlgorithm algorithm)
+{
+    switch (algorithm) {
+        case EDebounceAlgorithm::WINDOW:
+            return "window";
+        case EDebounceAlgorithm::INTEGRATOR:
+            return "integrator";
+        case EDebounceAlgorithm::MAJORITY:
+            return "majority";
+        case EDebounceAlgorithm::PULSE:
+            return "pulse";
+        default:
+            return "<unknown (" + to_string((int)algorithm) + ")>";
+    }
+}
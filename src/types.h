@@ -14,6 +14,17 @@ enum class EGpioEdge : uint8_t
 void EnumerateGpioEdge(const std::string&, EGpioEdge&);
 std::string GpioEdgeToString(EGpioEdge);
 
+enum class EDebounceAlgorithm : uint8_t
+{
+    WINDOW,     // no edges for debounce time
+    INTEGRATOR, // saturating counter of samples
+    MAJORITY,   // N of M samples
+    PULSE       // minimal pulse width
+};
+
+void EnumerateDebounceAlgorithm(const std::string&, EDebounceAlgorithm&);
+std::string DebounceAlgorithmToString(EDebounceAlgorithm);
+
 enum class EInterruptSupport : uint8_t
 {
     UNKNOWN,
@@ -21,24 +32,39 @@ enum class EInterruptSupport : uint8_t
     NO
 };
 
+/* Value holder that remembers whether it was changed since last publication */
 template<typename T> class TValue
 {
     T Value;
+    bool Changed;
 
 public:
-    TValue(): Value(TValue())
+    TValue(): Value(), Changed(false)
     {}
 
-    TValue(T value): Value(value)
+    TValue(T value): Value(value), Changed(false)
     {}
 
     void Set(T value)
     {
-        Value = value;
+        if (Value != value) {
+            Value = value;
+            Changed = true;
+        }
     }
 
     T Get() const
     {
         return Value;
     }
+
+    bool IsChanged() const
+    {
+        return Changed;
+    }
+
+    void ResetChanged()
+    {
+        Changed = false;
+    }
 };
@@ -30,7 +30,7 @@ TEST_F(TConfigTest, no_file)
 
 TEST_F(TConfigTest, bad_config)
 {
-    for (size_t i = 1; i <= 9; ++i) {
+    for (size_t i = 1; i <= 10; ++i) {
         ASSERT_THROW(LoadConfig(testRootDir + "/bad/bad" + std::to_string(i) + ".conf", "", "", schemaFile),
                      std::runtime_error)
             << "bad" << i << ".conf";
@@ -59,6 +59,14 @@ TEST_F(TConfigTest, good_config)
     ASSERT_EQ(cfg.Chips[0].Lines[0].Offset, 15);
     ASSERT_EQ(cfg.Chips[0].Lines[0].Type, "watt_meter");
     ASSERT_EQ(cfg.Chips[0].Lines[0].DebounceTimeout, std::chrono::microseconds(20000));
+    ASSERT_EQ(cfg.Chips[0].Lines[0].KernelDebounce, true);
+    ASSERT_EQ(cfg.Chips[0].Lines[0].DebounceAlgorithm, EDebounceAlgorithm::WINDOW);
+    ASSERT_EQ(cfg.Chips[0].Lines[0].MaxEdgeRate, 0);
+    ASSERT_EQ(cfg.Chips[0].Poll.Interval, std::chrono::milliseconds(50));
+    ASSERT_EQ(cfg.Chips[0].Poll.FastInterval, std::chrono::milliseconds(5));
+    ASSERT_EQ(cfg.Chips[0].Poll.FastHold, std::chrono::milliseconds(2000));
+    ASSERT_EQ(cfg.Chips[0].Lane, "expanders");
+    ASSERT_EQ(cfg.WorkerThreads, 2);
 }
 
 TEST_F(TConfigTest, optional_config)
@@ -83,6 +91,13 @@ TEST_F(TConfigTest, optional_config)
     ASSERT_EQ(cfg.Chips[0].Lines[0].Offset, 152);
     ASSERT_EQ(cfg.Chips[0].Lines[0].Type, "water_meter");
     ASSERT_EQ(cfg.Chips[0].Lines[0].DebounceTimeout, std::chrono::microseconds(10000));
+    ASSERT_EQ(cfg.Chips[0].Lines[0].DebounceAlgorithm, EDebounceAlgorithm::MAJORITY);
+    ASSERT_EQ(cfg.Chips[0].Lines[0].DebounceSamples, 10);
+    ASSERT_EQ(cfg.Chips[0].Lines[0].DebounceVotes, 6);
+    ASSERT_EQ(cfg.Chips[0].Lines[0].MaxEdgeRate, 500);
+    ASSERT_EQ(cfg.Chips[0].Poll.Interval, std::chrono::milliseconds(500));
+    ASSERT_EQ(cfg.Chips[0].Poll.FastInterval, std::chrono::milliseconds::zero());
+    ASSERT_EQ(cfg.WorkerThreads, 1);
 }
 
 TEST_F(TConfigTest, full_main_config)
@@ -149,6 +164,8 @@ TEST_F(TConfigTest, line_override)
     ASSERT_EQ(cfg.Chips[0].Lines[0].Offset, 152);
     ASSERT_EQ(cfg.Chips[0].Lines[0].Type, "watt_meter");
     ASSERT_EQ(cfg.Chips[0].Lines[0].DebounceTimeout, std::chrono::microseconds(30000));
+    ASSERT_EQ(GetDebounceTimeout(cfg.Chips[0].Lines[0], true), std::chrono::microseconds(2000));
+    ASSERT_EQ(GetDebounceTimeout(cfg.Chips[0].Lines[0], false), std::chrono::microseconds(30000));
 }
 
 TEST_F(TConfigTest, good_config_debug_option)
@@ -68,6 +68,21 @@ TEST_F(TDebounceTest, value_is_unstable)
     ASSERT_EQ(fakeGpioLine->GetValue(), initialGpioState);
 }
 
+TEST_F(TDebounceTest, kernel_debounced_value_is_committed_at_once)
+{
+    uint8_t initialGpioState = 0, assumedGpioState = 1;
+    auto now = std::chrono::steady_clock::now();
+    const auto fakeGpioLine = std::make_shared<TGpioLine>(fakeGpioLineConfig);
+    fakeGpioLine->SetDebouncedByKernel(true);
+
+    InitGpioLine(fakeGpioLine, initialGpioState);
+    HandleGpioEvent(fakeGpioLine, assumedGpioState, now);
+
+    ASSERT_TRUE(fakeGpioLine->UpdateIfStable(now));
+    ASSERT_EQ(fakeGpioLine->GetValue(), assumedGpioState);
+    ASSERT_EQ(fakeGpioLine->GetCounter()->GetTotal(), 1);
+}
+
 TEST_F(TDebounceTest, count_debounce_not_firing)
 {
     uint32_t betweenEventsUs = 1000000;
@@ -204,3 +219,26 @@ TEST_F(TDebounceEdgeTest, falling_ignores_short_spike_caught_low)
     ASSERT_TRUE(line->UpdateIfStable(tReturn + std::chrono::microseconds(debounceTimeoutUs + 1)));
     ASSERT_EQ(line->GetCounter()->GetTotal(), 0);
 }
+
+TEST_F(TDebounceTest, asymmetric_windows)
+{
+    fakeGpioLineConfig.DebounceTimeoutRising = std::chrono::microseconds(2000);
+    auto now = std::chrono::steady_clock::now();
+    const auto line = std::make_shared<TGpioLine>(fakeGpioLineConfig);
+    InitGpioLine(line, 0);
+
+    // press is committed after the short window
+    HandleGpioEvent(line, 1, now);
+    ASSERT_EQ(line->GetDebounceDeadline(), now + std::chrono::microseconds(2000));
+    ASSERT_FALSE(line->UpdateIfStable(now + std::chrono::microseconds(1999)));
+    ASSERT_TRUE(line->UpdateIfStable(now + std::chrono::microseconds(2000)));
+    ASSERT_EQ(line->GetValue(), 1);
+
+    // release has to settle for the whole default window
+    auto release = now + std::chrono::microseconds(1000000);
+    HandleGpioEvent(line, 0, release);
+    ASSERT_EQ(line->GetDebounceDeadline(), release + std::chrono::microseconds(debounceTimeoutUs));
+    ASSERT_FALSE(line->UpdateIfStable(release + std::chrono::microseconds(2000)));
+    ASSERT_TRUE(line->UpdateIfStable(release + std::chrono::microseconds(debounceTimeoutUs)));
+    ASSERT_EQ(line->GetValue(), 0);
+}
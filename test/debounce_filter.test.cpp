@@ -0,0 +1,295 @@
+#include "config.h"
+#include "gpio_counter.h"
+#include "gpio_line.h"
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace
+{
+    struct TEdge
+    {
+        int64_t TimeUs;
+        uint8_t Level;
+
+        bool operator==(const TEdge& other) const
+        {
+            return TimeUs == other.TimeUs && Level == other.Level;
+        }
+    };
+
+    std::ostream& operator<<(std::ostream& os, const TEdge& edge)
+    {
+        return os << "{" << edge.TimeUs << ", " << int(edge.Level) << "}";
+    }
+
+    using TEdges = std::vector<TEdge>;
+
+    const auto START = TTimePoint(std::chrono::hours(1));
+
+    // Bounce patterns of the inputs, edge times in microseconds
+
+    // relay contact closes with 1.1 ms of bounce, opens 200 ms later with 0.3 ms of bounce
+    const TEdges RELAY = {{1000, 1},
+                          {1150, 0},
+                          {1300, 1},
+                          {1420, 0},
+                          {1700, 1},
+                          {1760, 0},
+                          {2100, 1},
+                          {201000, 0},
+                          {201080, 1},
+                          {201300, 0}};
+
+    // closed contact near a contactor: 20 us spikes every 500 us, then it opens at 50 ms
+    // and the spikes go on for 50 ms more
+    TEdges MakeNoisyContact()
+    {
+        TEdges edges = {{0, 1}};
+        for (int64_t t = 500; t < 100000; t += 500) {
+            uint8_t level = (t < 50000) ? 1 : 0;
+            if (t == 50000) {
+                edges.push_back({t, 0});
+                continue;
+            }
+            edges.push_back({t, uint8_t(!level)});
+            edges.push_back({t + 20, level});
+        }
+        return edges;
+    }
+
+    // reed switch of a meter: 10 pulses of 30 ms every 100 ms, bounce of the leading edge
+    // differs from pulse to pulse
+    TEdges MakeMeterPulses()
+    {
+        const int64_t bounceUs[] = {0, 400, 1200, 150, 900, 1500, 300, 0, 1100, 600};
+        TEdges edges;
+        for (int i = 0; i < 10; ++i) {
+            int64_t start = 1000 + i * 100000;
+            edges.push_back({start, 1});
+            for (int64_t t = 100; t < bounceUs[i]; t += 200) {
+                edges.push_back({start + t, 0});
+                edges.push_back({start + t + 50, 1});
+            }
+            edges.push_back({start + 30000, 0});
+        }
+        return edges;
+    }
+
+    PGpioLine MakeLine(const TGpioLineConfig& config, uint8_t initialLevel)
+    {
+        auto line = std::make_shared<TGpioLine>(config);
+        line->SetCachedValue(initialLevel);
+        line->SetCachedValueUnfiltered(initialLevel);
+        line->ClearDirty();
+        return line;
+    }
+
+    /* Feeds edges to line and commits settled levels at their deadlines, as TGpioChipDriver does.
+       Returns committed changes */
+    TEdges Feed(const PGpioLine& line, const TEdges& edges, int64_t endUs)
+    {
+        TEdges committed;
+        auto settle = [&](const TTimePoint& time) {
+            auto deadline = line->GetDebounceDeadline();
+            if (deadline <= time) {
+                auto value = line->GetValue();
+                line->UpdateIfStable(deadline);
+                if (line->GetValue() != value) {
+                    auto us = std::chrono::duration_cast<std::chrono::microseconds>(deadline - START).count();
+                    committed.push_back({us, line->GetValue()});
+                }
+            }
+        };
+        for (const auto& edge: edges) {
+            auto time = START + std::chrono::microseconds(edge.TimeUs);
+            settle(time);
+            line->HandleEdge(edge.Level, time);
+        }
+        settle(START + std::chrono::microseconds(endUs));
+        return committed;
+    }
+
+    /* Straightforward sampling of the level every sampleUs, a reference for event-driven filters */
+    template<typename TSampleHandler>
+    void Sample(const TEdges& edges, uint8_t initialLevel, int64_t sampleUs, int64_t endUs, TSampleHandler handler)
+    {
+        size_t next = 0;
+        uint8_t level = initialLevel;
+        for (int64_t t = sampleUs; t <= endUs; t += sampleUs) {
+            // edge at the very time of a sample is not seen by it
+            while (next < edges.size() && edges[next].TimeUs < t) {
+                level = edges[next++].Level;
+            }
+            handler(t, level);
+        }
+    }
+
+    /* Rising from 0 to threshold takes risingSamples high samples, falling back takes fallingSamples low ones */
+    TEdges IntegrateSamples(const TEdges& edges,
+                            uint8_t initialLevel,
+                            int64_t sampleUs,
+                            uint32_t risingSamples,
+                            uint32_t fallingSamples,
+                            int64_t endUs)
+    {
+        TEdges committed;
+        uint32_t threshold = risingSamples * fallingSamples;
+        uint32_t count = initialLevel ? threshold : 0;
+        uint8_t output = initialLevel;
+        Sample(edges, initialLevel, sampleUs, endUs, [&](int64_t t, uint8_t level) {
+            count = level ? std::min(threshold, count + fallingSamples)
+                          : (count > risingSamples ? count - risingSamples : 0);
+            if ((count == threshold && !output) || (count == 0 && output)) {
+                output = !output;
+                committed.push_back({t, output});
+            }
+        });
+        return committed;
+    }
+
+    /* Windows are {samples, votes} of low and high level */
+    TEdges VoteSamples(const TEdges& edges,
+                       uint8_t initialLevel,
+                       int64_t sampleUs,
+                       const std::pair<uint32_t, uint32_t> (&windows)[2],
+                       int64_t endUs)
+    {
+        TEdges committed;
+        std::vector<uint8_t> history(std::max(windows[0].first, windows[1].first), initialLevel);
+        uint8_t output = initialLevel;
+        Sample(edges, initialLevel, sampleUs, endUs, [&](int64_t t, uint8_t level) {
+            history.erase(history.begin());
+            history.push_back(level);
+            auto samples = windows[level].first;
+            uint32_t agree = std::count(history.end() - samples, history.end(), level);
+            if (level != output && agree >= windows[level].second) {
+                output = level;
+                committed.push_back({t, output});
+            }
+        });
+        return committed;
+    }
+} // namespace
+
+class TDebounceFilterTest: public testing::Test
+{
+protected:
+    TGpioLineConfig Config;
+
+    void SetUp()
+    {
+        Config.Name = "input";
+        Config.Direction = EGpioDirection::Input;
+        Config.DebounceTimeout = std::chrono::microseconds(2000);
+    }
+};
+
+TEST_F(TDebounceFilterTest, window)
+{
+    EXPECT_EQ(Feed(MakeLine(Config, 0), RELAY, 300000), (TEdges{{4100, 1}, {203300, 0}}));
+
+    // continuous noise never leaves a 2 ms gap without edges, so the window filter never settles
+    EXPECT_EQ(Feed(MakeLine(Config, 1), MakeNoisyContact(), 100000), TEdges{});
+}
+
+TEST_F(TDebounceFilterTest, integrator)
+{
+    Config.DebounceAlgorithm = EDebounceAlgorithm::INTEGRATOR;
+    Config.DebounceSamples = 5; // sample every 400 us
+    for (uint8_t initialLevel: {0, 1}) {
+        auto committed = Feed(MakeLine(Config, initialLevel), RELAY, 300000);
+        EXPECT_EQ(committed, IntegrateSamples(RELAY, initialLevel, 400, 5, 5, 300000));
+    }
+
+    auto noisy = MakeNoisyContact();
+    auto committed = Feed(MakeLine(Config, 1), noisy, 110000);
+    EXPECT_EQ(committed, IntegrateSamples(noisy, 1, 400, 5, 5, 110000));
+    ASSERT_EQ(committed.size(), 1u);
+    EXPECT_EQ(committed[0].Level, 0);
+    EXPECT_LT(committed[0].TimeUs, 50000 + 4000);
+}
+
+TEST_F(TDebounceFilterTest, majority)
+{
+    Config.DebounceAlgorithm = EDebounceAlgorithm::MAJORITY;
+    Config.DebounceSamples = 8; // sample every 250 us
+    Config.DebounceVotes = 6;
+    for (uint8_t initialLevel: {0, 1}) {
+        auto committed = Feed(MakeLine(Config, initialLevel), RELAY, 300000);
+        EXPECT_EQ(committed, VoteSamples(RELAY, initialLevel, 250, {{8, 6}, {8, 6}}, 300000));
+    }
+
+    auto noisy = MakeNoisyContact();
+    auto committed = Feed(MakeLine(Config, 1), noisy, 110000);
+    EXPECT_EQ(committed, VoteSamples(noisy, 1, 250, {{8, 6}, {8, 6}}, 110000));
+    ASSERT_EQ(committed.size(), 1u);
+    EXPECT_EQ(committed[0].Level, 0);
+    EXPECT_LT(committed[0].TimeUs, 50000 + 4000);
+}
+
+TEST_F(TDebounceFilterTest, sampling_per_edge)
+{
+    // contact closes for 2 ms and opens for 800 us: 5 samples of 400 us to close, 2 to open
+    Config.DebounceTimeoutRising = std::chrono::microseconds(2000);
+    Config.DebounceTimeoutFalling = std::chrono::microseconds(800);
+    Config.DebounceSamples = 5;
+    Config.DebounceVotes = 4;
+    const TEdges clean = {{1000, 1}, {10000, 0}};
+
+    Config.DebounceAlgorithm = EDebounceAlgorithm::INTEGRATOR;
+    EXPECT_EQ(Feed(MakeLine(Config, 0), clean, 20000), (TEdges{{2800, 1}, {10800, 0}}));
+    for (uint8_t initialLevel: {0, 1}) {
+        auto committed = Feed(MakeLine(Config, initialLevel), RELAY, 300000);
+        EXPECT_EQ(committed, IntegrateSamples(RELAY, initialLevel, 400, 5, 2, 300000));
+    }
+
+    // votes of the shorter window are scaled with it: 2 of 2 samples
+    Config.DebounceAlgorithm = EDebounceAlgorithm::MAJORITY;
+    EXPECT_EQ(Feed(MakeLine(Config, 0), clean, 20000), (TEdges{{2400, 1}, {10800, 0}}));
+    for (uint8_t initialLevel: {0, 1}) {
+        auto committed = Feed(MakeLine(Config, initialLevel), RELAY, 300000);
+        EXPECT_EQ(committed, VoteSamples(RELAY, initialLevel, 400, {{2, 2}, {5, 4}}, 300000));
+    }
+}
+
+TEST_F(TDebounceFilterTest, pulse)
+{
+    Config.DebounceAlgorithm = EDebounceAlgorithm::PULSE;
+
+    // gaps within the bounce don't restart the window: settled 2 ms after the first edge plus the gaps
+    EXPECT_EQ(Feed(MakeLine(Config, 0), RELAY, 300000), (TEdges{{3770, 1}, {203220, 0}}));
+
+    // a spike shorter than the window is dropped
+    EXPECT_EQ(Feed(MakeLine(Config, 0), {{1000, 1}, {2500, 0}, {2600, 1}, {2700, 0}}, 10000), TEdges{});
+}
+
+TEST_F(TDebounceFilterTest, pulse_counter)
+{
+    // leading edges of pulses come every 100 ms, so every period measured by the counter is the same,
+    // while settling times of the window filter follow the bounce
+    Config.Type = "water_meter";
+    Config.InterruptEdge = EGpioEdge::RISING;
+    auto pulses = MakeMeterPulses();
+
+    for (auto algorithm: {EDebounceAlgorithm::PULSE, EDebounceAlgorithm::WINDOW}) {
+        Config.DebounceAlgorithm = algorithm;
+        auto line = MakeLine(Config, 0);
+        std::vector<float> currents;
+        size_t next = 0;
+        for (int i = 0; i < 10; ++i) {
+            TEdges pulse;
+            for (; next < pulses.size() && pulses[next].TimeUs < 1000 + (i + 1) * 100000; ++next) {
+                pulse.push_back(pulses[next]);
+            }
+            Feed(line, pulse, 1000 + (i + 1) * 100000);
+            currents.push_back(line->GetCounter()->GetCurrent());
+        }
+        EXPECT_EQ(line->GetCounter()->GetCounts(), 10u);
+        bool isPeriodExact = std::all_of(currents.begin() + 1, currents.end(), [&](float current) {
+            return current == currents[1];
+        });
+        EXPECT_EQ(isPeriodExact, algorithm == EDebounceAlgorithm::PULSE)
+            << DebounceAlgorithmToString(algorithm);
+    }
+}
@@ -0,0 +1,292 @@
+#include "config.h"
+#include "edge_trace.h"
+#include "exceptions.h"
+#include "gpio_chip_driver.h"
+#include "gpio_counter.h"
+#include "gpio_line.h"
+#include "interruption_context.h"
+#include "simulated_gpio_backend.h"
+#include "trace_replay.h"
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <sstream>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace
+{
+    const auto CHIP_PATH = "/dev/gpiochip100";
+
+    TGpioLineConfig MakeCounterConfig(uint32_t offset)
+    {
+        TGpioLineConfig config;
+        config.Offset = offset;
+        config.Name = "counter" + std::to_string(offset);
+        config.Direction = EGpioDirection::Input;
+        config.InterruptEdge = EGpioEdge::RISING;
+        config.Type = "watt_meter";
+        config.Multiplier = 1000;
+        config.DebounceTimeout = std::chrono::microseconds(1000);
+        return config;
+    }
+
+    TTimePoint At(std::chrono::microseconds time)
+    {
+        return TTimePoint(time);
+    }
+
+    /* Replays trace and returns published values, a line per control update. Error is published as "!<error>" */
+    std::string Replay(const TGpioDriverConfig& config, const std::string& traceFile)
+    {
+        std::ostringstream published;
+        TTraceReplay replay(config);
+        replay.Run(traceFile, [&](const TTimePoint& time, const TControlUpdates& updates) {
+            for (const auto& update: updates) {
+                published << time.time_since_epoch().count() << " " << update.Id << " "
+                          << (update.Error.empty() ? update.Value : "!" + update.Error) << "\n";
+            }
+        });
+        return published.str();
+    }
+
+    std::string GetLastValue(const std::string& published, const std::string& id)
+    {
+        std::istringstream lines(published);
+        std::string time, lineId, value, lastValue;
+        while (lines >> time >> lineId >> value) {
+            if (lineId == id) {
+                lastValue = value;
+            }
+        }
+        return lastValue;
+    }
+} // namespace
+
+class TEdgeTraceTest: public testing::Test
+{
+protected:
+    std::string TraceFile;
+    TGpioDriverConfig Config;
+
+    void SetUp()
+    {
+        TraceFile = testing::TempDir() + "edge_trace.test.trace";
+        Config.Chips.emplace_back(CHIP_PATH);
+    }
+
+    void TearDown()
+    {
+        unlink(TraceFile.c_str());
+    }
+};
+
+TEST_F(TEdgeTraceTest, round_trip)
+{
+    auto counterConfig = MakeCounterConfig(0);
+    TGpioLineConfig polledConfig;
+    polledConfig.Name = "polled";
+    polledConfig.Direction = EGpioDirection::Input;
+    auto counterLine = std::make_shared<TGpioLine>(counterConfig);
+    auto polledLine = std::make_shared<TGpioLine>(polledConfig);
+    polledLine->SetInterruptSupport(EInterruptSupport::NO);
+    counterLine->GetCounter()->SetInitialValues(12.5);
+    counterLine->SetDebouncedByKernel(true);
+
+    {
+        TEdgeTraceWriter writer(TraceFile);
+        writer.WriteEdge(*counterLine, 1, At(std::chrono::microseconds(100)));
+        writer.WritePollSample({polledLine, counterLine}, 0b10, At(std::chrono::microseconds(200)));
+        writer.WritePollSample({polledLine, counterLine}, 0b10, At(std::chrono::microseconds(300))); // the same
+        writer.WriteLevel(*counterLine, 0, At(std::chrono::microseconds(400)));
+    }
+
+    TEdgeTraceReader reader(TraceFile);
+    TEdgeTraceRecord record;
+
+    ASSERT_TRUE(reader.Next(record));
+    EXPECT_EQ(record.Type, EEdgeTraceRecordType::LINE);
+    EXPECT_EQ(record.Id, 0);
+    EXPECT_EQ(record.Name, "counter0");
+    EXPECT_EQ(record.Flags, TEdgeTraceRecord::FLAG_DEBOUNCED_BY_KERNEL);
+    EXPECT_EQ(record.CounterEdge, EGpioEdge::RISING);
+    EXPECT_EQ(record.CounterTotal, 12.5);
+
+    ASSERT_TRUE(reader.Next(record));
+    EXPECT_EQ(record.Type, EEdgeTraceRecordType::EDGE);
+    EXPECT_EQ(record.Id, 0);
+    EXPECT_EQ(record.Values, 1u);
+    EXPECT_EQ(record.Time, At(std::chrono::microseconds(100)));
+
+    ASSERT_TRUE(reader.Next(record));
+    EXPECT_EQ(record.Type, EEdgeTraceRecordType::LINE);
+    EXPECT_EQ(record.Id, 1);
+    EXPECT_EQ(record.Name, "polled");
+    EXPECT_EQ(record.Flags, TEdgeTraceRecord::FLAG_POLLED);
+
+    ASSERT_TRUE(reader.Next(record));
+    EXPECT_EQ(record.Type, EEdgeTraceRecordType::GROUP);
+    EXPECT_EQ(record.Id, 0);
+    EXPECT_EQ(record.LineIds, std::vector<uint16_t>({1, 0}));
+
+    ASSERT_TRUE(reader.Next(record));
+    EXPECT_EQ(record.Type, EEdgeTraceRecordType::POLL);
+    EXPECT_EQ(record.Id, 0);
+    EXPECT_EQ(record.Values, 0b10u);
+    EXPECT_EQ(record.Time, At(std::chrono::microseconds(200)));
+
+    ASSERT_TRUE(reader.Next(record));
+    EXPECT_EQ(record.Type, EEdgeTraceRecordType::LEVEL);
+    EXPECT_EQ(record.Values, 0u);
+    EXPECT_EQ(record.Time, At(std::chrono::microseconds(400)));
+
+    EXPECT_FALSE(reader.Next(record));
+}
+
+TEST_F(TEdgeTraceTest, malformed_trace)
+{
+    {
+        std::ofstream file(TraceFile);
+        file << "not a trace";
+    }
+    EXPECT_THROW(TEdgeTraceReader reader(TraceFile), TGpioDriverException);
+
+    auto line = std::make_shared<TGpioLine>(MakeCounterConfig(0));
+    {
+        TEdgeTraceWriter writer(TraceFile);
+        writer.WriteEdge(*line, 1, At(std::chrono::microseconds(100)));
+    }
+    truncate(TraceFile.c_str(), 20);
+    TEdgeTraceReader reader(TraceFile);
+    TEdgeTraceRecord record;
+    EXPECT_THROW(reader.Next(record), TGpioDriverException);
+}
+
+TEST_F(TEdgeTraceTest, replay_is_deterministic)
+{
+    auto counterConfig = MakeCounterConfig(0);
+    Config.Chips.back().Lines.push_back(counterConfig);
+    auto line = std::make_shared<TGpioLine>(counterConfig);
+
+    // 20 pulses of 100 ms period, every edge bounces for 300 us
+    {
+        TEdgeTraceWriter writer(TraceFile);
+        auto time = std::chrono::microseconds(1000000);
+        for (int pulse = 0; pulse < 20; ++pulse) {
+            for (uint8_t level: {1, 0}) {
+                for (int bounce = 0; bounce < 3; ++bounce) {
+                    writer.WriteEdge(*line, level, At(time));
+                    writer.WriteEdge(*line, !level, At(time + std::chrono::microseconds(50)));
+                    time += std::chrono::microseconds(100);
+                }
+                writer.WriteEdge(*line, level, At(time));
+                time += std::chrono::microseconds(50000) - std::chrono::microseconds(300);
+            }
+        }
+    }
+
+    auto published = Replay(Config, TraceFile);
+    EXPECT_EQ(published, Replay(Config, TraceFile));
+
+    // bounces are filtered, so 20 impulses of 1000 per kWh are counted
+    EXPECT_EQ(GetLastValue(published, "counter0_total"), "0.020");
+    // current power decays to zero after the last pulse
+    EXPECT_EQ(GetLastValue(published, "counter0_current"), "0.000");
+}
+
+TEST_F(TEdgeTraceTest, replay_of_poll_samples)
+{
+    auto counterConfig = MakeCounterConfig(0);
+    counterConfig.DebounceTimeout = std::chrono::microseconds(20000);
+    Config.Chips.back().Lines.push_back(counterConfig);
+    Config.Chips.back().Poll.Interval = std::chrono::milliseconds(10);
+    auto line = std::make_shared<TGpioLine>(counterConfig);
+    line->SetInterruptSupport(EInterruptSupport::NO);
+
+    // 20 pulses of 40 ms every 100 ms sampled every 10 ms, and a spike seen by a single sample
+    {
+        TEdgeTraceWriter writer(TraceFile);
+        for (int sample = 100; sample < 320; ++sample) {
+            auto phase = sample % 10;
+            uint8_t level = (sample < 300) ? (phase < 4) : (phase == 5);
+            writer.WritePollSample({line}, level, At(std::chrono::milliseconds(sample * 10)));
+        }
+    }
+
+    // debounced by samples, so 20 impulses of 1000 per kWh are counted
+    auto published = Replay(Config, TraceFile);
+    EXPECT_EQ(GetLastValue(published, "counter0_total"), "0.020");
+}
+
+TEST_F(TEdgeTraceTest, replay_of_interrupt_storm)
+{
+    auto inputConfig = MakeCounterConfig(0);
+    inputConfig.Name = "input";
+    inputConfig.Type.clear();
+    inputConfig.MaxEdgeRate = 100; // 10 edges per 100 ms
+    Config.Chips.back().Lines.push_back(inputConfig);
+    auto line = std::make_shared<TGpioLine>(inputConfig);
+
+    // edges every 1 ms exceed the rate, then the line is read by storm polls and settles at 1
+    {
+        TEdgeTraceWriter writer(TraceFile);
+        for (int edge = 0; edge < 20; ++edge) {
+            writer.WriteEdge(*line, edge % 2, At(std::chrono::milliseconds(1000 + edge)));
+        }
+        writer.WriteLevel(*line, 1, At(std::chrono::milliseconds(1100)));
+    }
+
+    auto published = Replay(Config, TraceFile);
+    EXPECT_NE(published.find(" input !r\n"), std::string::npos);
+    // interrupts are enabled back after the quiet period, the line is published without error
+    EXPECT_EQ(GetLastValue(published, "input"), "1");
+}
+
+TEST_F(TEdgeTraceTest, replay_of_recorded_driver)
+{
+    auto backend = std::make_shared<TSimulatedGpioBackend>();
+    TSimulatedGpioChipConfig simulatedChip;
+    simulatedChip.Path = CHIP_PATH;
+    simulatedChip.LineCount = 8;
+    backend->AddChip(simulatedChip);
+
+    Config.Chips.back().Lines.push_back(MakeCounterConfig(0));
+    auto input = MakeCounterConfig(1);
+    input.Name = "input";
+    input.Type.clear();
+    Config.Chips.back().Lines.push_back(input);
+
+    uint64_t counts = 0;
+    uint8_t inputValue = 0;
+    {
+        TEdgeTraceWriter writer(TraceFile);
+        TGpioChipDriver driver(Config.Chips.back(), backend);
+        driver.SetTraceWriter(&writer);
+        auto epfd = epoll_create(1);
+        driver.AddToEpoll(epfd);
+
+        TBounceProfile bounce;
+        bounce.Count = 2;
+        for (int i = 0; i < 10; ++i) {
+            backend->Toggle(CHIP_PATH, 0, bounce);
+            backend->Toggle(CHIP_PATH, 1);
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(5);
+            struct epoll_event events[8]{};
+            while (std::chrono::steady_clock::now() < deadline) {
+                if (int count = epoll_wait(epfd, events, 8, 1)) {
+                    TInterruptionContext ctx{count, events};
+                    TGpioChipDriver::HandleInterrupt(ctx);
+                }
+            }
+        }
+        auto lines = driver.MapLinesByOffset();
+        counts = lines[0]->GetCounter()->GetCounts();
+        inputValue = lines[1]->GetValue();
+        close(epfd);
+    }
+    ASSERT_EQ(counts, 5u);
+
+    auto published = Replay(Config, TraceFile);
+    EXPECT_EQ(GetLastValue(published, "counter0_total"), "0.005");
+    EXPECT_EQ(GetLastValue(published, "input"), std::to_string(inputValue));
+}
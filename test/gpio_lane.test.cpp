@@ -0,0 +1,39 @@
+#include "config.h"
+#include "gpio_lane.h"
+#include <gtest/gtest.h>
+
+TEST(TGpioLaneTest, select_lane)
+{
+    // on-SoC banks are read in microseconds
+    ASSERT_EQ(TGpioLane::SelectLane("", std::chrono::microseconds(5)), TGpioLane::MAIN);
+    // I2C expanders need a bus transfer
+    ASSERT_EQ(TGpioLane::SelectLane("", std::chrono::milliseconds(1)), TGpioLane::SLOW);
+    // configured lane is used as is
+    ASSERT_EQ(TGpioLane::SelectLane("buttons", std::chrono::milliseconds(1)), "buttons");
+    ASSERT_EQ(TGpioLane::SelectLane(TGpioLane::MAIN, std::chrono::milliseconds(1)), TGpioLane::MAIN);
+}
+
+TEST(TGpioLaneTest, worker_schedule)
+{
+    TGpioDriverConfig config;
+    config.WorkerPriority = 50;
+    config.WorkerCpu = 1;
+
+    // main lane and its shards are real-time, shard N is pinned to worker_cpu + N
+    auto schedule = TGpioLane::GetWorkerSchedule(TGpioLane::MAIN, config);
+    ASSERT_EQ(schedule.Priority, 50);
+    ASSERT_EQ(schedule.Cpu, 1);
+    schedule = TGpioLane::GetWorkerSchedule("main-2", config);
+    ASSERT_EQ(schedule.Priority, 50);
+    ASSERT_EQ(schedule.Cpu, 3);
+
+    // lanes of expanders may busy-wait in bus transfers, they must not preempt main lane on its CPU
+    for (const auto& name: {TGpioLane::SLOW, "buttons", "main-x"}) {
+        schedule = TGpioLane::GetWorkerSchedule(name, config);
+        ASSERT_EQ(schedule.Priority, 0) << name;
+        ASSERT_EQ(schedule.Cpu, -1) << name;
+    }
+
+    config.WorkerCpu = -1;
+    ASSERT_EQ(TGpioLane::GetWorkerSchedule("main-1", config).Cpu, -1);
+}
@@ -140,6 +140,26 @@ TEST_F(TGpioCounterGetEdgeTest, counter_update_current)
     ASSERT_EQ(fakeGpioLine->GetCounter()->GetCurrent(), assumedCurrent / 4);
 }
 
+TEST_F(TGpioCounterGetEdgeTest, counter_update_deadlines)
+{
+    fakeGpioLineConfig.InterruptEdge = EGpioEdge::RISING;
+    const auto fakeGpioLine = std::make_shared<TFakeGpioLine>(fakeGpioLineConfig);
+    const auto& counter = fakeGpioLine->GetCounter();
+    auto interval = std::chrono::microseconds(100000);
+    auto us = [](int64_t count) { return std::chrono::microseconds(count); };
+
+    ASSERT_EQ(counter->GetNextUpdateInterval(us(0)), std::chrono::microseconds::max()); // nothing to decay
+
+    counter->HandleInterrupt(EGpioEdge::RISING, interval);
+    ASSERT_EQ(counter->GetNextUpdateInterval(us(0)), interval + us(1));              // decay starts
+    ASSERT_EQ(counter->GetNextUpdateInterval(interval + us(1)), interval + us(500001)); // decay step
+    ASSERT_EQ(counter->GetNextUpdateInterval(us(9950000)), 100 * interval + us(1));     // zeroing
+
+    counter->Update(100 * interval + us(1));
+    ASSERT_EQ(counter->GetCurrent(), 0);
+    ASSERT_EQ(counter->GetNextUpdateInterval(100 * interval + us(1)), std::chrono::microseconds::max());
+}
+
 // Regression harness for the "all inputs disappearing" bug. A counter line on a
 // chip without interrupt support shares a single polled fd with all the other
 // inputs. AutoDetectInterruptEdges() must NOT call ReListenLine() for such a
@@ -0,0 +1,117 @@
+#include "config.h"
+#include "declarations.h"
+#include "gpio_chip_driver.h"
+#include "gpio_counter.h"
+#include "gpio_line.h"
+#include "publish_queue.h"
+#include "types.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+    class TFakeGpioLine: public TGpioLine
+    {
+    public:
+        TFakeGpioLine(const TGpioLineConfig& config): TGpioLine(config)
+        {}
+        bool IsOutput() const
+        {
+            return false;
+        }
+        std::string DescribeShort() const
+        {
+            return "Mocked gpio line";
+        }
+    };
+
+    class TFakeGpioChipDriver: public TGpioChipDriver
+    {
+    public:
+        // Fake fds, see gpiocounter.test.cpp: the base dtor close()s every fd key in Lines
+        void AddLine(const PGpioLine& line, int fd)
+        {
+            Lines[fd].push_back(line);
+        }
+    };
+
+    // Publish pass of the GPIO worker: counts control writes
+    size_t PublishCycle(const std::shared_ptr<TFakeGpioChipDriver>& driver)
+    {
+        TControlUpdates updates;
+        driver->ForEachDirtyLine([&](const PGpioLine& line) { AppendControlUpdates(line, updates); });
+        return updates.size();
+    }
+} // namespace
+
+class TGpioLineDirtyTest: public testing::Test
+{
+protected:
+    PGpioLine InputLine;
+    PGpioLine CounterLine;
+    std::shared_ptr<TFakeGpioChipDriver> Driver;
+
+    void SetUp()
+    {
+        TGpioLineConfig config;
+        config.Direction = EGpioDirection::Input;
+        config.Offset = 0;
+        config.Name = "input";
+        InputLine = std::make_shared<TFakeGpioLine>(config);
+
+        config.Offset = 1;
+        config.Name = "counter";
+        config.Type = "water_meter";
+        config.InterruptEdge = EGpioEdge::RISING;
+        CounterLine = std::make_shared<TFakeGpioLine>(config);
+
+        Driver = std::make_shared<TFakeGpioChipDriver>();
+        Driver->AddLine(InputLine, 100051);
+        Driver->AddLine(CounterLine, 100052);
+    }
+};
+
+TEST_F(TGpioLineDirtyTest, idle_cycle_has_no_writes)
+{
+    InputLine->SetCachedValue(1);
+    CounterLine->GetCounter()->SetInitialValues(10);
+    ASSERT_EQ(PublishCycle(Driver), 3u); // initial state is published once
+
+    ASSERT_EQ(PublishCycle(Driver), 0u);
+    ASSERT_EQ(PublishCycle(Driver), 0u);
+}
+
+TEST_F(TGpioLineDirtyTest, same_value_is_not_published)
+{
+    PublishCycle(Driver);
+
+    InputLine->SetCachedValue(InputLine->GetValue());
+    CounterLine->GetCounter()->SetInitialValues(CounterLine->GetCounter()->GetTotal());
+    ASSERT_EQ(PublishCycle(Driver), 0u);
+}
+
+TEST_F(TGpioLineDirtyTest, changed_line_is_published_once)
+{
+    PublishCycle(Driver);
+
+    InputLine->SetCachedValue(!InputLine->GetValue());
+    ASSERT_EQ(PublishCycle(Driver), 1u);
+    ASSERT_EQ(PublishCycle(Driver), 0u);
+
+    CounterLine->GetCounter()->HandleInterrupt(EGpioEdge::RISING, std::chrono::seconds(1));
+    ASSERT_EQ(PublishCycle(Driver), 2u);
+}
+
+TEST_F(TGpioLineDirtyTest, error_is_published_once)
+{
+    PublishCycle(Driver);
+
+    InputLine->SetError("r");
+    ASSERT_EQ(PublishCycle(Driver), 1u);
+    InputLine->SetError("r");
+    ASSERT_EQ(PublishCycle(Driver), 0u);
+
+    InputLine->ClearError();
+    ASSERT_EQ(PublishCycle(Driver), 1u);
+    InputLine->ClearError();
+    ASSERT_EQ(PublishCycle(Driver), 0u);
+}
@@ -0,0 +1,57 @@
+#include "mpsc_queue.h"
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+TEST(TMpscQueueTest, fifo_order)
+{
+    TMpscQueue<int> queue;
+    int value;
+    ASSERT_FALSE(queue.Pop(value));
+
+    for (int i = 0; i < 10; ++i) {
+        queue.Push(i);
+    }
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_TRUE(queue.Pop(value));
+        ASSERT_EQ(value, i);
+    }
+    ASSERT_FALSE(queue.Pop(value));
+}
+
+TEST(TMpscQueueTest, concurrent_producers)
+{
+    const int producerCount = 4;
+    const int itemCount = 20000;
+
+    TMpscQueue<std::pair<int, int>> queue; // producer, sequence number
+    std::vector<std::thread> producers;
+    for (int p = 0; p < producerCount; ++p) {
+        producers.emplace_back([&queue, p] {
+            for (int i = 0; i < itemCount; ++i) {
+                queue.Push({p, i});
+            }
+        });
+    }
+
+    std::vector<int> expected(producerCount, 0);
+    bool isOrdered = true;
+    int popped = 0;
+    std::pair<int, int> item;
+    while (popped < producerCount * itemCount) {
+        if (!queue.Pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        isOrdered &= (item.second == expected[item.first]); // per-producer order is kept
+        ++expected[item.first];
+        ++popped;
+    }
+
+    for (auto& producer: producers) {
+        producer.join();
+    }
+    ASSERT_TRUE(isOrdered);
+    ASSERT_FALSE(queue.Pop(item));
+}
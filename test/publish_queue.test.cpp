@@ -0,0 +1,106 @@
+#include "config.h"
+#include "gpio_line.h"
+#include "publish_queue.h"
+#include <gtest/gtest.h>
+
+#include <poll.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    class TFakeGpioLine: public TGpioLine
+    {
+    public:
+        TFakeGpioLine(const TGpioLineConfig& config): TGpioLine(config)
+        {}
+        bool IsOutput() const
+        {
+            return false;
+        }
+        std::string DescribeShort() const
+        {
+            return "Mocked gpio line";
+        }
+    };
+
+    bool IsSignalled(int fd)
+    {
+        pollfd pfd{fd, POLLIN, 0};
+        return poll(&pfd, 1, 0) == 1;
+    }
+} // namespace
+
+TEST(TPublishQueueTest, control_updates)
+{
+    TGpioLineConfig config;
+    config.Direction = EGpioDirection::Input;
+    config.Name = "input";
+    auto input = std::make_shared<TFakeGpioLine>(config);
+    input->SetCachedValue(1);
+
+    config.Name = "counter";
+    config.Type = "water_meter";
+    config.InterruptEdge = EGpioEdge::RISING;
+    auto counter = std::make_shared<TFakeGpioLine>(config);
+
+    TControlUpdates updates;
+    AppendControlUpdates(input, updates);
+    ASSERT_EQ(updates.size(), 1u);
+    ASSERT_EQ(updates[0].Id, "input");
+    ASSERT_EQ(updates[0].Value, "1");
+    ASSERT_TRUE(updates[0].Error.empty());
+
+    AppendControlUpdates(counter, updates);
+    ASSERT_EQ(updates.size(), 3u); // total and current
+
+    input->SetError("r");
+    updates.clear();
+    AppendControlUpdates(input, updates);
+    ASSERT_EQ(updates.size(), 1u);
+    ASSERT_EQ(updates[0].Id, "input");
+    ASSERT_EQ(updates[0].Error, "r");
+
+    // counter has no control of line name, the error is set to all its controls
+    counter->SetError("r");
+    updates.clear();
+    AppendControlUpdates(counter, updates);
+    ASSERT_EQ(updates.size(), 2u);
+    ASSERT_EQ(updates[0].Id, "counter_total");
+    ASSERT_EQ(updates[0].Error, "r");
+    ASSERT_EQ(updates[1].Id, "counter_current");
+    ASSERT_EQ(updates[1].Error, "r");
+}
+
+TEST(TPublishQueueTest, batches_of_workers_are_merged)
+{
+    const int workerCount = 4;
+    const int batchCount = 1000;
+
+    TPublishQueue queue;
+    ASSERT_FALSE(IsSignalled(queue.GetFd()));
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < workerCount; ++w) {
+        workers.emplace_back([&queue, w] {
+            for (int i = 0; i < batchCount; ++i) {
+                queue.Push({{std::to_string(w), std::to_string(i), ""}});
+            }
+        });
+    }
+    for (auto& worker: workers) {
+        worker.join();
+    }
+    ASSERT_TRUE(IsSignalled(queue.GetFd()));
+
+    // batches of each worker come in order they were pushed
+    std::vector<int> next(workerCount, 0);
+    auto count = queue.Drain([&](const TControlUpdates& batch) {
+        ASSERT_EQ(batch.size(), 1u);
+        auto worker = std::stoi(batch[0].Id);
+        ASSERT_EQ(std::stoi(batch[0].Value), next[worker]);
+        ++next[worker];
+    });
+    ASSERT_EQ(count, static_cast<size_t>(workerCount * batchCount));
+    ASSERT_FALSE(IsSignalled(queue.GetFd()));
+}
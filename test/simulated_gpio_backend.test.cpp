@@ -0,0 +1,169 @@
+#include "config.h"
+#include "gpio_chip_driver.h"
+#include "gpio_line.h"
+#include "interruption_context.h"
+#include "simulated_gpio_backend.h"
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace
+{
+    const auto CHIP_PATH = "/dev/gpiochip100";
+
+    TGpioLineConfig MakeLineConfig(uint32_t offset, EGpioDirection direction)
+    {
+        TGpioLineConfig config;
+        config.Offset = offset;
+        config.Name = "line" + std::to_string(offset);
+        config.Direction = direction;
+        config.DebounceTimeout = std::chrono::microseconds(1000);
+        return config;
+    }
+
+    /* Runs worker loop of the chip driver until condition is met */
+    bool RunUntil(int epfd, const std::function<bool()>& condition)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        struct epoll_event events[8]{};
+        while (!condition()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            if (int count = epoll_wait(epfd, events, 8, 10)) {
+                TInterruptionContext ctx{count, events};
+                TGpioChipDriver::HandleInterrupt(ctx);
+            }
+        }
+        return true;
+    }
+} // namespace
+
+class TSimulatedGpioBackendTest: public testing::Test
+{
+protected:
+    PSimulatedGpioBackend Backend = std::make_shared<TSimulatedGpioBackend>();
+    TSimulatedGpioChipConfig SimulatedChip;
+    TGpioChipConfig ChipConfig{CHIP_PATH};
+    int Epfd = -1;
+
+    void SetUp()
+    {
+        SimulatedChip.Path = CHIP_PATH;
+        SimulatedChip.LineCount = 8;
+        Epfd = epoll_create(1);
+    }
+
+    void TearDown()
+    {
+        close(Epfd);
+    }
+};
+
+TEST_F(TSimulatedGpioBackendTest, interrupt_inputs)
+{
+    Backend->AddChip(SimulatedChip);
+    auto kernelDebounced = MakeLineConfig(0, EGpioDirection::Input);
+    kernelDebounced.KernelDebounce = true;
+    ChipConfig.Lines.push_back(kernelDebounced);
+    ChipConfig.Lines.push_back(MakeLineConfig(1, EGpioDirection::Input));
+
+    TGpioChipDriver driver(ChipConfig, Backend);
+    driver.AddToEpoll(Epfd);
+    auto lines = driver.MapLinesByOffset();
+    ASSERT_EQ(lines.size(), 2u);
+    ASSERT_TRUE(lines[0]->IsDebouncedByKernel());
+    ASSERT_FALSE(lines[1]->IsDebouncedByKernel());
+
+    TBounceProfile bounce;
+    bounce.Count = 3;
+    bounce.Interval = std::chrono::microseconds(50);
+    Backend->Toggle(CHIP_PATH, 0, bounce);
+    Backend->Toggle(CHIP_PATH, 1, bounce);
+
+    ASSERT_TRUE(RunUntil(Epfd, [&] { return lines[0]->GetValue() && lines[1]->GetValue(); }));
+
+    Backend->SetLevel(CHIP_PATH, 1, false);
+    ASSERT_TRUE(RunUntil(Epfd, [&] { return !lines[1]->GetValue(); }));
+    ASSERT_EQ(Backend->GetDroppedEventCount(), 0u);
+}
+
+TEST_F(TSimulatedGpioBackendTest, interrupt_inputs_uapi_v1)
+{
+    SimulatedChip.UapiV2Supported = false;
+    Backend->AddChip(SimulatedChip);
+    ChipConfig.Lines.push_back(MakeLineConfig(0, EGpioDirection::Input));
+
+    TGpioChipDriver driver(ChipConfig, Backend);
+    driver.AddToEpoll(Epfd);
+    auto line = driver.MapLinesByOffset()[0];
+    ASSERT_EQ(line->GetInterruptSupport(), EInterruptSupport::YES);
+
+    Backend->Toggle(CHIP_PATH, 0);
+    ASSERT_TRUE(RunUntil(Epfd, [&] { return line->GetValue() == 1; }));
+}
+
+TEST_F(TSimulatedGpioBackendTest, polled_inputs)
+{
+    SimulatedChip.UapiV2Supported = false;
+    SimulatedChip.InterruptsSupported = false;
+    Backend->AddChip(SimulatedChip);
+    ChipConfig.Lines.push_back(MakeLineConfig(2, EGpioDirection::Input));
+    ChipConfig.Lines.push_back(MakeLineConfig(3, EGpioDirection::Input));
+    ChipConfig.Poll.Interval = std::chrono::milliseconds(5);
+
+    TGpioChipDriver driver(ChipConfig, Backend);
+    driver.AddToEpoll(Epfd);
+    auto lines = driver.MapLinesByOffset();
+    ASSERT_EQ(lines[2]->GetInterruptSupport(), EInterruptSupport::NO);
+    ASSERT_EQ(lines[2]->GetFd(), lines[3]->GetFd()); // read by a single request
+
+    Backend->SetLevel(CHIP_PATH, 3, true);
+    ASSERT_TRUE(RunUntil(Epfd, [&] { return lines[3]->GetValue() == 1; }));
+    ASSERT_EQ(lines[2]->GetValue(), 0);
+}
+
+TEST_F(TSimulatedGpioBackendTest, outputs)
+{
+    Backend->AddChip(SimulatedChip);
+    auto output = MakeLineConfig(4, EGpioDirection::Output);
+    output.InitialState = true;
+    ChipConfig.Lines.push_back(output);
+    auto activeLow = MakeLineConfig(5, EGpioDirection::Output);
+    activeLow.IsActiveLow = true;
+    ChipConfig.Lines.push_back(activeLow);
+
+    TGpioChipDriver driver(ChipConfig, Backend);
+    auto lines = driver.MapLinesByOffset();
+    ASSERT_TRUE(Backend->GetLevel(CHIP_PATH, 4));
+    ASSERT_TRUE(Backend->GetLevel(CHIP_PATH, 5));
+
+    lines[4]->SetValue(0);
+    lines[5]->SetValue(1);
+    ASSERT_FALSE(Backend->GetLevel(CHIP_PATH, 4));
+    ASSERT_FALSE(Backend->GetLevel(CHIP_PATH, 5));
+    ASSERT_TRUE(lines[5]->GetError().empty());
+}
+
+TEST_F(TSimulatedGpioBackendTest, edge_generator)
+{
+    Backend->AddChip(SimulatedChip);
+    ChipConfig.Lines.push_back(MakeLineConfig(6, EGpioDirection::Input));
+
+    TGpioChipDriver driver(ChipConfig, Backend);
+    driver.AddToEpoll(Epfd);
+    auto line = driver.MapLinesByOffset()[6];
+
+    TSimulatedSignal signal;
+    signal.Path = CHIP_PATH;
+    signal.Offset = 6;
+    signal.Period = std::chrono::microseconds(20000);
+    TSimulatedEdgeGenerator generator(Backend, {signal});
+    generator.Start();
+    ASSERT_TRUE(RunUntil(Epfd, [&] { return line->GetValue() == 1; }));
+    ASSERT_TRUE(RunUntil(Epfd, [&] { return line->GetValue() == 0; }));
+    generator.Stop();
+    ASSERT_GE(generator.GetToggleCount(), 2u);
+}
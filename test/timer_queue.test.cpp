@@ -0,0 +1,132 @@
+#include "config.h"
+#include "gpio_line.h"
+#include "timer_queue.h"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+class TTimerQueueTest: public testing::Test
+{
+protected:
+    std::vector<PGpioLine> Lines;
+    TTimePoint Now;
+
+    void SetUp()
+    {
+        for (uint32_t i = 0; i < 3; ++i) {
+            TGpioLineConfig config;
+            config.Offset = i;
+            config.Name = "line" + std::to_string(i);
+            Lines.push_back(std::make_shared<TGpioLine>(config));
+        }
+        Now = std::chrono::steady_clock::now();
+    }
+
+    std::vector<uint32_t> Expire(TTimerQueue& queue, const TTimePoint& now)
+    {
+        std::vector<uint32_t> expired;
+        queue.HandleExpired(now, [&](const PGpioLine& line) { expired.push_back(line->GetOffset()); });
+        return expired;
+    }
+};
+
+TEST_F(TTimerQueueTest, expires_in_deadline_order)
+{
+    TTimerQueue queue;
+    queue.Schedule(Lines[2], Now + std::chrono::milliseconds(30));
+    queue.Schedule(Lines[0], Now + std::chrono::milliseconds(10));
+    queue.Schedule(Lines[1], Now + std::chrono::milliseconds(20));
+
+    ASSERT_TRUE(Expire(queue, Now).empty());
+    ASSERT_EQ(Expire(queue, Now + std::chrono::milliseconds(20)), std::vector<uint32_t>({0, 1}));
+    ASSERT_FALSE(queue.IsEmpty());
+    ASSERT_EQ(Expire(queue, Now + std::chrono::milliseconds(30)), std::vector<uint32_t>({2}));
+    ASSERT_TRUE(queue.IsEmpty());
+}
+
+TEST_F(TTimerQueueTest, reschedule_from_handler)
+{
+    TTimerQueue queue;
+    queue.Schedule(Lines[0], Now + std::chrono::milliseconds(10));
+
+    size_t calls = 0;
+    queue.HandleExpired(Now + std::chrono::milliseconds(10), [&](const PGpioLine& line) {
+        ++calls;
+        queue.Schedule(line, Now + std::chrono::milliseconds(50));
+    });
+    ASSERT_EQ(calls, 1u);
+    ASSERT_FALSE(queue.IsEmpty());
+    ASSERT_EQ(Expire(queue, Now + std::chrono::milliseconds(50)), std::vector<uint32_t>({0}));
+}
+
+TEST_F(TTimerQueueTest, advance)
+{
+    TTimerQueue queue(GetSteadyClock(), &TGpioLine::AccessDebounceQueuePosition);
+    queue.Reserve(Lines.size());
+    queue.Schedule(Lines[0], Now + std::chrono::milliseconds(10));
+    queue.Schedule(Lines[1], Now + std::chrono::milliseconds(30));
+
+    // the entry of the line moves, no new one is added
+    queue.Advance(Lines[1], Now + std::chrono::milliseconds(5));
+    queue.Advance(Lines[1], Now + std::chrono::milliseconds(20));
+    queue.Advance(Lines[2], Now + std::chrono::milliseconds(15));
+    ASSERT_EQ(queue.GetEarliestDeadline(), Now + std::chrono::milliseconds(5));
+    ASSERT_EQ(Expire(queue, Now + std::chrono::milliseconds(30)), std::vector<uint32_t>({1, 0, 2}));
+    ASSERT_TRUE(queue.IsEmpty());
+    for (const auto& line: Lines) {
+        ASSERT_EQ(line->AccessDebounceQueuePosition(), TTimerQueue::NO_POSITION);
+    }
+}
+
+TEST_F(TTimerQueueTest, advance_keeps_positions)
+{
+    // deadlines of many lines are advanced in random order, every line expires once and in deadline order
+    std::vector<PGpioLine> lines;
+    for (uint32_t i = 0; i < 100; ++i) {
+        TGpioLineConfig config;
+        config.Offset = i;
+        lines.push_back(std::make_shared<TGpioLine>(config));
+    }
+    TTimerQueue queue(GetSteadyClock(), &TGpioLine::AccessDebounceQueuePosition);
+    std::vector<std::chrono::milliseconds> deadlines(lines.size(), std::chrono::milliseconds::max());
+    uint32_t seed = 1;
+    for (int i = 0; i < 1000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        auto offset = (seed >> 16) % lines.size();
+        auto deadline = std::chrono::milliseconds(1 + (seed >> 8) % 1000);
+        queue.Advance(lines[offset], Now + deadline);
+        deadlines[offset] = std::min(deadlines[offset], deadline);
+    }
+
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 0; i < lines.size(); ++i) {
+        if (deadlines[i] != std::chrono::milliseconds::max()) {
+            expected.push_back(i);
+        }
+    }
+    std::stable_sort(expected.begin(), expected.end(), [&deadlines](uint32_t a, uint32_t b) {
+        return deadlines[a] < deadlines[b];
+    });
+
+    std::vector<uint32_t> expired;
+    queue.HandleExpired(Now + std::chrono::seconds(1), [&](const PGpioLine& line) {
+        expired.push_back(line->GetOffset());
+    });
+    ASSERT_EQ(expired.size(), expected.size());
+    for (size_t i = 0; i < expired.size(); ++i) {
+        ASSERT_EQ(deadlines[expired[i]], deadlines[expected[i]]) << i;
+    }
+    ASSERT_TRUE(queue.IsEmpty());
+}
+
+TEST_F(TTimerQueueTest, latency_stats)
+{
+    TTimerQueue queue;
+    queue.Schedule(Lines[0], Now + std::chrono::milliseconds(10));
+    Expire(queue, Now + std::chrono::milliseconds(12));
+
+    auto stats = queue.TakeLatencyStats();
+    ASSERT_EQ(stats.Count, 1u);
+    ASSERT_EQ(stats.Max, std::chrono::milliseconds(2));
+    ASSERT_EQ(queue.TakeLatencyStats().Count, 0u);
+}
@@ -0,0 +1,531 @@
+#include "clock.h"
+#include "config.h"
+#include "gpio_chip_driver.h"
+#include "gpio_counter.h"
+#include "gpio_line.h"
+#include "interrupt_storm_guard.h"
+#include "interruption_context.h"
+#include "publish_queue.h"
+#include "simulated_gpio_backend.h"
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace
+{
+    const auto CHIP_PATH = "/dev/gpiochip100";
+
+    TGpioLineConfig MakeInputConfig(uint32_t offset)
+    {
+        TGpioLineConfig config;
+        config.Offset = offset;
+        config.Name = "input" + std::to_string(offset);
+        config.Direction = EGpioDirection::Input;
+        config.DebounceTimeout = std::chrono::milliseconds(10);
+        return config;
+    }
+
+    TGpioLineConfig MakeCounterConfig(uint32_t offset)
+    {
+        auto config = MakeInputConfig(offset);
+        config.InterruptEdge = EGpioEdge::RISING;
+        config.Type = "watt_meter";
+        config.Multiplier = 1000;
+        return config;
+    }
+} // namespace
+
+class TVirtualTimeTest: public testing::Test
+{
+protected:
+    PSimulatedClock Clock = std::make_shared<TSimulatedClock>();
+    PSimulatedGpioBackend Backend = std::make_shared<TSimulatedGpioBackend>(Clock);
+    TSimulatedGpioChipConfig SimulatedChip;
+    TGpioChipConfig ChipConfig{CHIP_PATH};
+    int Epfd = -1;
+
+    void SetUp()
+    {
+        SimulatedChip.Path = CHIP_PATH;
+        SimulatedChip.LineCount = 8;
+        Epfd = epoll_create(1);
+    }
+
+    void TearDown()
+    {
+        close(Epfd);
+    }
+
+    void DispatchEvents()
+    {
+        struct epoll_event events[8]{};
+        while (int count = epoll_wait(Epfd, events, 8, 0)) {
+            TInterruptionContext ctx{count, events};
+            TGpioChipDriver::HandleInterrupt(ctx);
+        }
+    }
+
+    /* Dispatches pending events and moves clock to time, handling every timer deadline on the way */
+    void AdvanceTo(TGpioChipDriver& driver, const TTimePoint& time)
+    {
+        DispatchEvents();
+        for (auto deadline = driver.GetNextTimerDeadline(); deadline <= time;
+             deadline = driver.GetNextTimerDeadline())
+        {
+            Clock->SetTime(std::max(deadline, Clock->Now()));
+            driver.HandleTimers();
+        }
+        Clock->SetTime(time);
+    }
+
+    void Advance(TGpioChipDriver& driver, const std::chrono::nanoseconds& interval)
+    {
+        AdvanceTo(driver, Clock->Now() + interval);
+    }
+
+    /* An hour of 1 Hz meter with contact bounce, returns published values of the counter */
+    std::string RunMeterHour()
+    {
+        Backend->AddChip(SimulatedChip);
+        ChipConfig.Lines.push_back(MakeCounterConfig(0));
+        TGpioChipDriver driver(ChipConfig, Backend, Clock);
+        driver.AddToEpoll(Epfd);
+        auto counterLine = driver.MapLinesByOffset().at(0);
+
+        std::ostringstream published;
+        auto collect = [&](const PGpioLine& line) {
+            for (const auto& idValue: line->GetCounter()->GetIdsAndValues(line->GetConfig()->Name)) {
+                published << Clock->Now().time_since_epoch().count() << " " << idValue.first << " "
+                          << idValue.second << "\n";
+            }
+        };
+
+        TBounceProfile bounce;
+        bounce.Count = 3;
+        for (int second = 0; second < 3600; ++second) {
+            Backend->Toggle(CHIP_PATH, 0, bounce);
+            Advance(driver, std::chrono::milliseconds(500));
+            driver.ForEachDirtyLine(collect);
+            Backend->Toggle(CHIP_PATH, 0, bounce);
+            Advance(driver, std::chrono::milliseconds(500));
+            driver.ForEachDirtyLine(collect);
+        }
+        EXPECT_EQ(counterLine->GetCounter()->GetCounts(), 3600u);
+
+        // current value decays to zero without pulses
+        Advance(driver, std::chrono::minutes(10));
+        driver.ForEachDirtyLine(collect);
+        EXPECT_EQ(counterLine->GetCounter()->GetCurrent(), 0);
+        return published.str();
+    }
+
+    /* Toggles line every 1 ms edges times */
+    void MakeEdges(uint32_t offset, int edges)
+    {
+        for (int i = 0; i < edges; ++i) {
+            Backend->Toggle(CHIP_PATH, offset);
+            Clock->Advance(std::chrono::milliseconds(1));
+        }
+        DispatchEvents();
+    }
+};
+
+TEST_F(TVirtualTimeTest, debounce)
+{
+    Backend->AddChip(SimulatedChip);
+    ChipConfig.Lines.push_back(MakeInputConfig(0));
+    TGpioChipDriver driver(ChipConfig, Backend, Clock);
+    driver.AddToEpoll(Epfd);
+    auto line = driver.MapLinesByOffset().at(0);
+
+    auto edgeTime = Clock->Now();
+    Backend->SetLevel(CHIP_PATH, 0, true);
+    Advance(driver, std::chrono::microseconds(9999));
+    EXPECT_EQ(line->GetValue(), 0);
+    EXPECT_EQ(driver.GetNextTimerDeadline(), edgeTime + std::chrono::milliseconds(10));
+
+    // an edge within the window prolongs it
+    Backend->SetLevel(CHIP_PATH, 0, false);
+    Backend->SetLevel(CHIP_PATH, 0, true);
+    Advance(driver, std::chrono::milliseconds(5));
+    EXPECT_EQ(line->GetValue(), 0);
+    Advance(driver, std::chrono::milliseconds(5));
+    EXPECT_EQ(line->GetValue(), 1);
+    EXPECT_EQ(driver.GetNextTimerDeadline(), TTimePoint::max());
+}
+
+TEST_F(TVirtualTimeTest, asymmetric_debounce)
+{
+    Backend->AddChip(SimulatedChip);
+    auto config = MakeInputConfig(0);
+    config.DebounceTimeoutRising = std::chrono::milliseconds(2);
+    config.DebounceTimeoutFalling = std::chrono::milliseconds(50);
+    ChipConfig.Lines.push_back(config);
+    TGpioChipDriver driver(ChipConfig, Backend, Clock);
+    driver.AddToEpoll(Epfd);
+    auto line = driver.MapLinesByOffset().at(0);
+
+    Backend->SetLevel(CHIP_PATH, 0, true);
+    Advance(driver, std::chrono::milliseconds(2));
+    EXPECT_EQ(line->GetValue(), 1);
+
+    // a short release is ignored, the press is kept without waiting for the release window
+    Backend->SetLevel(CHIP_PATH, 0, false);
+    Advance(driver, std::chrono::milliseconds(1));
+    auto pressTime = Clock->Now();
+    Backend->SetLevel(CHIP_PATH, 0, true);
+    Backend->SetLevel(CHIP_PATH, 0, false);
+    Backend->SetLevel(CHIP_PATH, 0, true);
+    DispatchEvents();
+    EXPECT_EQ(driver.GetNextTimerDeadline(), pressTime + std::chrono::milliseconds(2));
+    Advance(driver, std::chrono::milliseconds(60));
+    EXPECT_EQ(line->GetValue(), 1);
+    EXPECT_EQ(driver.GetNextTimerDeadline(), TTimePoint::max());
+
+    Backend->SetLevel(CHIP_PATH, 0, false);
+    Advance(driver, std::chrono::microseconds(49999));
+    EXPECT_EQ(line->GetValue(), 1);
+    Advance(driver, std::chrono::microseconds(1));
+    EXPECT_EQ(line->GetValue(), 0);
+}
+
+TEST_F(TVirtualTimeTest, debounce_uapi_v1)
+{
+    // uAPI v1 events are timestamped by realtime of the simulated clock
+    SimulatedChip.UapiV2Supported = false;
+    Backend->AddChip(SimulatedChip);
+    ChipConfig.Lines.push_back(MakeInputConfig(0));
+    TGpioChipDriver driver(ChipConfig, Backend, Clock);
+    driver.AddToEpoll(Epfd);
+    auto line = driver.MapLinesByOffset().at(0);
+
+    auto edgeTime = Clock->Now();
+    Backend->SetLevel(CHIP_PATH, 0, true);
+    Advance(driver, std::chrono::milliseconds(1));
+    EXPECT_EQ(line->GetInterruptionTimepoint(), edgeTime);
+    Advance(driver, std::chrono::milliseconds(9));
+    EXPECT_EQ(line->GetValue(), 1);
+}
+
+TEST_F(TVirtualTimeTest, polled_inputs)
+{
+    SimulatedChip.InterruptsSupported = false;
+    Backend->AddChip(SimulatedChip);
+    ChipConfig.Lines.push_back(MakeInputConfig(0));
+    TGpioChipDriver driver(ChipConfig, Backend, Clock);
+    driver.AddToEpoll(Epfd);
+    auto line = driver.MapLinesByOffset().at(0);
+
+    Backend->SetLevel(CHIP_PATH, 0, true);
+    Advance(driver, DEFAULT_POLL_INTERVAL);
+    EXPECT_EQ(line->GetValue(), 0);
+
+    // the level seen by a sample is committed by another sample at its debounce deadline
+    EXPECT_EQ(driver.GetNextTimerDeadline(), Clock->Now() + std::chrono::milliseconds(10));
+    Advance(driver, std::chrono::microseconds(9999));
+    EXPECT_EQ(line->GetValue(), 0);
+    Advance(driver, std::chrono::microseconds(1));
+    EXPECT_EQ(line->GetValue(), 1);
+
+    // the extra sample doesn't move regular ones
+    EXPECT_EQ(driver.GetNextTimerDeadline(), Clock->Now() + DEFAULT_POLL_INTERVAL - std::chrono::milliseconds(10));
+
+    Backend->SetLevel(CHIP_PATH, 0, false);
+    Advance(driver, DEFAULT_POLL_INTERVAL);
+    EXPECT_EQ(line->GetValue(), 0);
+
+    // a spike seen by a single sample is dropped by the confirming one
+    Advance(driver, DEFAULT_POLL_INTERVAL - std::chrono::milliseconds(15));
+    Backend->SetLevel(CHIP_PATH, 0, true);
+    Advance(driver, std::chrono::milliseconds(20));
+    Backend->SetLevel(CHIP_PATH, 0, false);
+    Advance(driver, DEFAULT_POLL_INTERVAL);
+    EXPECT_EQ(line->GetValue(), 0);
+}
+
+TEST_F(TVirtualTimeTest, polled_counter)
+{
+    // meter on an expander without IRQ, pulses of 40 ms every 100 ms are sampled every 10 ms
+    SimulatedChip.InterruptsSupported = false;
+    Backend->AddChip(SimulatedChip);
+    auto config = MakeCounterConfig(0);
+    config.DebounceTimeout = std::chrono::milliseconds(20);
+    ChipConfig.Lines.push_back(config);
+    ChipConfig.Poll.Interval = std::chrono::milliseconds(10);
+    TGpioChipDriver driver(ChipConfig, Backend, Clock);
+    driver.AddToEpoll(Epfd);
+    auto counter = driver.MapLinesByOffset().at(0);
+
+    Advance(driver, std::chrono::microseconds(13500));
+    TBounceProfile bounce;
+    bounce.Count = 3;
+    for (int i = 0; i < 50; ++i) {
+        Backend->Toggle(CHIP_PATH, 0, bounce);
+        Advance(driver, std::chrono::milliseconds(40));
+        Backend->Toggle(CHIP_PATH, 0, bounce);
+        Advance(driver, std::chrono::milliseconds(60));
+    }
+    EXPECT_EQ(counter->GetCounter()->GetCounts(), 50u);
+
+    // 10 pulses per second of 1000 pulses per kWh is 36 kW
+    EXPECT_FLOAT_EQ(counter->GetCounter()->GetCurrent(), 36000);
+}
+
+TEST_F(TVirtualTimeTest, meter_hour_is_reproducible)
+{
+    auto published = RunMeterHour();
+    EXPECT_NE(published.find("input0_total 3.600"), std::string::npos);
+
+    TearDown();
+    Clock = std::make_shared<TSimulatedClock>();
+    Backend = std::make_shared<TSimulatedGpioBackend>(Clock);
+    ChipConfig.Lines.clear();
+    SetUp();
+    EXPECT_EQ(RunMeterHour(), published);
+}
+
+TEST_F(TVirtualTimeTest, zero_debounce_commits_edges_in_order)
+{
+    Backend->AddChip(SimulatedChip);
+    auto inputConfig = MakeInputConfig(0);
+    inputConfig.DebounceTimeout = std::chrono::microseconds::zero();
+    ChipConfig.Lines.push_back(inputConfig);
+    auto counterConfig = MakeCounterConfig(1);
+    counterConfig.DebounceTimeout = std::chrono::microseconds::zero();
+    ChipConfig.Lines.push_back(counterConfig);
+    TGpioChipDriver driver(ChipConfig, Backend, Clock);
+    driver.AddToEpoll(Epfd);
+    auto input = driver.MapLinesByOffset().at(0);
+    auto counter = driver.MapLinesByOffset().at(1);
+
+    // levels of a batch of events are committed in their order, every rising edge is counted
+    for (int i = 0; i < 5; ++i) {
+        Backend->SetLevel(CHIP_PATH, 0, i % 2 == 0);
+        Backend->SetLevel(CHIP_PATH, 1, i % 2 == 0);
+        Clock->Advance(std::chrono::microseconds(100));
+    }
+    DispatchEvents();
+    EXPECT_EQ(input->GetValue(), 1);
+    EXPECT_EQ(counter->GetValue(), 1);
+    EXPECT_EQ(counter->GetCounter()->GetCounts(), 3u);
+    EXPECT_EQ(counter->GetInterruptionTimepoint(), Clock->Now() - std::chrono::microseconds(100));
+
+    // changes are published right after the wakeup, no debounce timer is armed
+    std::vector<std::string> published;
+    driver.ForEachDirtyLine([&](const PGpioLine& line) { published.push_back(line->GetConfig()->Name); });
+    EXPECT_EQ(published, (std::vector<std::string>{"input0", "input1"}));
+    EXPECT_GT(driver.GetNextTimerDeadline(), Clock->Now() + std::chrono::milliseconds(1));
+
+    Backend->SetLevel(CHIP_PATH, 0, false);
+    DispatchEvents();
+    EXPECT_EQ(input->GetValue(), 0);
+}
+
+TEST_F(TVirtualTimeTest, zero_debounce_uapi_v1)
+{
+    SimulatedChip.UapiV2Supported = false;
+    Backend->AddChip(SimulatedChip);
+    auto counterConfig = MakeCounterConfig(0);
+    counterConfig.DebounceTimeout = std::chrono::microseconds::zero();
+    ChipConfig.Lines.push_back(counterConfig);
+    TGpioChipDriver driver(ChipConfig, Backend, Clock);
+    driver.AddToEpoll(Epfd);
+    auto counter = driver.MapLinesByOffset().at(0);
+
+    for (int i = 0; i < 4; ++i) {
+        Backend->SetLevel(CHIP_PATH, 0, i % 2 == 0);
+        Clock->Advance(std::chrono::microseconds(100));
+    }
+    DispatchEvents();
+    EXPECT_EQ(counter->GetValue(), 0);
+    EXPECT_EQ(counter->GetCounter()->GetCounts(), 2u);
+}
+
+TEST_F(TVirtualTimeTest, interrupt_storm)
+{
+    Backend->AddChip(SimulatedChip);
+    auto stormConfig = MakeInputConfig(0);
+    stormConfig.MaxEdgeRate = 100; // 10 edges per 100 ms
+    ChipConfig.Lines.push_back(stormConfig);
+    ChipConfig.Lines.push_back(MakeInputConfig(1));
+    TGpioChipDriver driver(ChipConfig, Backend, Clock);
+    driver.AddToEpoll(Epfd);
+    auto line = driver.MapLinesByOffset().at(0);
+    auto neighbour = driver.MapLinesByOffset().at(1);
+
+    MakeEdges(0, 10);
+    EXPECT_FALSE(line->IsInterruptStorm());
+
+    MakeEdges(0, 2);
+    auto stormStart = Clock->Now();
+    EXPECT_TRUE(line->IsInterruptStorm());
+    EXPECT_EQ(line->GetControlError(), "r");
+    auto lastEdge = line->GetInterruptionTimepoint();
+
+    // the line is polled, other lines of the request keep interrupts
+    Backend->SetLevel(CHIP_PATH, 0, true);
+    Backend->SetLevel(CHIP_PATH, 1, true);
+    auto neighbourEdge = Clock->Now();
+    DispatchEvents();
+    EXPECT_EQ(line->GetInterruptionTimepoint(), lastEdge);
+    EXPECT_EQ(neighbour->GetInterruptionTimepoint(), neighbourEdge);
+    Advance(driver, DEFAULT_POLL_INTERVAL + std::chrono::milliseconds(10));
+    EXPECT_EQ(line->GetValue(), 1);
+    EXPECT_EQ(neighbour->GetValue(), 1);
+
+    // interrupts are enabled back after the quiet period
+    AdvanceTo(driver, stormStart + STORM_MIN_QUIET_PERIOD - std::chrono::milliseconds(1));
+    EXPECT_TRUE(line->IsInterruptStorm());
+    Advance(driver, std::chrono::milliseconds(1));
+    EXPECT_FALSE(line->IsInterruptStorm());
+    EXPECT_EQ(line->GetControlError(), "");
+    auto edgeTime = Clock->Now();
+    Backend->SetLevel(CHIP_PATH, 0, false);
+    DispatchEvents();
+    EXPECT_EQ(line->GetInterruptionTimepoint(), edgeTime);
+
+    // a storm soon after the previous one disables interrupts for twice as long
+    MakeEdges(0, 11);
+    EXPECT_TRUE(line->IsInterruptStorm());
+    EXPECT_EQ(line->GetInterruptStormGuard()->GetQuietPeriod(), 2 * STORM_MIN_QUIET_PERIOD);
+    Advance(driver, 2 * STORM_MIN_QUIET_PERIOD);
+    EXPECT_FALSE(line->IsInterruptStorm());
+}
+
+TEST_F(TVirtualTimeTest, interrupt_storm_of_counter)
+{
+    Backend->AddChip(SimulatedChip);
+    auto config = MakeCounterConfig(0);
+    config.MaxEdgeRate = 100;
+    ChipConfig.Lines.push_back(config);
+    TGpioChipDriver driver(ChipConfig, Backend, Clock);
+    driver.AddToEpoll(Epfd);
+    auto line = driver.MapLinesByOffset().at(0);
+
+    // the error is published to controls of the counter, the line has no control of its own
+    TControlUpdates updates;
+    auto collect = [&](const PGpioLine& line) { AppendControlUpdates(line, updates); };
+    MakeEdges(0, 11);
+    EXPECT_TRUE(line->IsInterruptStorm());
+    driver.ForEachDirtyLine(collect);
+    std::vector<std::string> errorIds;
+    for (const auto& update: updates) {
+        if (update.Error == "r") {
+            errorIds.push_back(update.Id);
+        }
+    }
+    EXPECT_EQ(errorIds, (std::vector<std::string>{"input0_total", "input0_current"}));
+
+    updates.clear();
+    Advance(driver, STORM_MIN_QUIET_PERIOD);
+    EXPECT_FALSE(line->IsInterruptStorm());
+    driver.ForEachDirtyLine(collect);
+    ASSERT_EQ(updates.size(), 2u);
+    EXPECT_EQ(updates[0].Id, "input0_total");
+    EXPECT_TRUE(updates[0].Error.empty());
+}
+
+TEST_F(TVirtualTimeTest, interrupt_storm_uapi_v1)
+{
+    SimulatedChip.UapiV2Supported = false;
+    Backend->AddChip(SimulatedChip);
+    auto config = MakeInputConfig(0);
+    config.MaxEdgeRate = 100;
+    ChipConfig.Lines.push_back(config);
+    TGpioChipDriver driver(ChipConfig, Backend, Clock);
+    driver.AddToEpoll(Epfd);
+    auto line = driver.MapLinesByOffset().at(0);
+
+    MakeEdges(0, 11);
+    EXPECT_TRUE(line->IsInterruptStorm());
+
+    // events of the line are not listened, its level is polled
+    MakeEdges(0, 11);
+    EXPECT_TRUE(line->IsInterruptStorm());
+
+    // the line is requested without events, so they are not queued while nobody reads them
+    for (int i = 0; i < 10000; ++i) {
+        Backend->Toggle(CHIP_PATH, 0);
+    }
+    EXPECT_EQ(Backend->GetDroppedEventCount(), 0u);
+    Advance(driver, DEFAULT_POLL_INTERVAL + std::chrono::milliseconds(10));
+    EXPECT_EQ(line->GetValue(), 0);
+    Backend->SetLevel(CHIP_PATH, 0, true);
+    Advance(driver, DEFAULT_POLL_INTERVAL + std::chrono::milliseconds(10));
+    EXPECT_EQ(line->GetValue(), 1);
+
+    Advance(driver, STORM_MIN_QUIET_PERIOD);
+    EXPECT_FALSE(line->IsInterruptStorm());
+    auto edgeTime = Clock->Now();
+    Backend->SetLevel(CHIP_PATH, 0, false);
+    Advance(driver, std::chrono::milliseconds(1));
+    EXPECT_EQ(line->GetInterruptionTimepoint(), edgeTime);
+}
+
+TEST_F(TVirtualTimeTest, interrupt_storm_uapi_v1_moved_to_epoll)
+{
+    SimulatedChip.UapiV2Supported = false;
+    Backend->AddChip(SimulatedChip);
+    auto config = MakeInputConfig(0);
+    config.MaxEdgeRate = 100;
+    ChipConfig.Lines.push_back(config);
+    TGpioChipDriver driver(ChipConfig, Backend, Clock);
+    driver.AddToEpoll(Epfd);
+    auto line = driver.MapLinesByOffset().at(0);
+
+    MakeEdges(0, 11);
+    EXPECT_TRUE(line->IsInterruptStorm());
+
+    // events of the line are not listened by the new epoll until the storm ends
+    close(Epfd);
+    Epfd = epoll_create(1);
+    driver.AddToEpoll(Epfd);
+    auto lastEdge = line->GetInterruptionTimepoint();
+    MakeEdges(0, 2);
+    EXPECT_EQ(line->GetInterruptionTimepoint(), lastEdge);
+
+    Advance(driver, STORM_MIN_QUIET_PERIOD);
+    EXPECT_FALSE(line->IsInterruptStorm());
+    auto edgeTime = Clock->Now();
+    Backend->SetLevel(CHIP_PATH, 0, !Backend->GetLevel(CHIP_PATH, 0));
+    Advance(driver, std::chrono::milliseconds(1));
+    EXPECT_EQ(line->GetInterruptionTimepoint(), edgeTime);
+}
+
+TEST_F(TVirtualTimeTest, readback_line_count)
+{
+    SimulatedChip.UapiV2Supported = false;
+    Backend->AddChip(SimulatedChip);
+    auto config = MakeInputConfig(0);
+    config.Readback = false;
+    config.MaxEdgeRate = 100;
+    ChipConfig.Lines.push_back(config);
+    config = MakeInputConfig(1);
+    config.Readback = false;
+    ChipConfig.Lines.push_back(config);
+    TGpioChipDriver driver(ChipConfig, Backend, Clock);
+    driver.AddToEpoll(Epfd);
+    auto line = driver.MapLinesByOffset().at(0);
+    auto neighbour = driver.MapLinesByOffset().at(1);
+    EXPECT_FALSE(driver.NeedsPolling());
+
+    // a line with error is read back until it recovers
+    neighbour->SetError("r");
+    EXPECT_TRUE(driver.NeedsPolling());
+    driver.PollLines();
+    EXPECT_EQ(neighbour->GetError(), "");
+    EXPECT_FALSE(driver.NeedsPolling());
+
+    // requests of the line are replaced on edge storm, it is still counted once
+    line->SetError("r");
+    MakeEdges(0, 11);
+    EXPECT_TRUE(line->IsInterruptStorm());
+    EXPECT_TRUE(driver.NeedsPolling());
+    driver.PollLines();
+    EXPECT_FALSE(driver.NeedsPolling());
+    Advance(driver, STORM_MIN_QUIET_PERIOD);
+    EXPECT_FALSE(line->IsInterruptStorm());
+    EXPECT_FALSE(driver.NeedsPolling());
+}